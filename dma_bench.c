@@ -0,0 +1,755 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA Operation Layer benchmark (implementation).
+ *
+ * It measures the cost of the DMA Xfer, DMA Operation and packet
+ * descriptor paths: for each configuration (module parameters), it
+ * reports the throughput, the latency percentiles of each stage and
+ * the number of allocations per transfer. The benchmark runs when the
+ * module is loaded and the results are written to the kernel log.
+ *
+ * It can be used with any DMA controller or with the software DMA
+ * engine (dev=dma-sw-engine).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/kthread.h>
+#include <linux/sched/task.h>
+#include <linux/sort.h>
+#include <linux/ktime.h>
+#include <linux/jiffies.h>
+#include <linux/completion.h>
+#include <linux/dma-mapping.h>
+#include <trace/events/kmem.h>
+
+#include "dma_block.h"
+#include "dma_sg.h"
+#include "dma_xfer.h"
+#include "dma_op.h"
+#include "packet_desc.h"
+
+#define DMA_BENCH_MAX_THREADS 32
+
+static char * mode = "sg";
+module_param(mode,charp,0444);
+MODULE_PARM_DESC(mode,"Benchmark mode: sg, cyclic, memcpy or pdesc");
+
+static char * dev = "";
+module_param(dev,charp,0444);
+MODULE_PARM_DESC(dev,"Name of the DMA device (empty: any)");
+
+static unsigned int size = 4096;
+module_param(size,uint,0444);
+MODULE_PARM_DESC(size,"Buffer size (bytes)");
+
+static char * shape = "contig";
+module_param(shape,charp,0444);
+MODULE_PARM_DESC(shape,"SG shape: contig, vmalloc or offset");
+
+static unsigned int offset = 64;
+module_param(offset,uint,0444);
+MODULE_PARM_DESC(offset,"Buffer offset of the offset shape (bytes)");
+
+static unsigned int tx;
+module_param(tx,uint,0444);
+MODULE_PARM_DESC(tx,"Direction of the slave modes (0: DEV_TO_MEM, 1: MEM_TO_DEV)");
+
+static unsigned int depth = 4;
+module_param(depth,uint,0444);
+MODULE_PARM_DESC(depth,"Transfers in flight per thread (periods in cyclic mode)");
+
+static unsigned int threads = 1;
+module_param(threads,uint,0444);
+MODULE_PARM_DESC(threads,"Number of threads");
+
+static unsigned int iterations = 10000;
+module_param(iterations,uint,0444);
+MODULE_PARM_DESC(iterations,"Transfers per thread (periods in cyclic mode)");
+
+static unsigned int timeout_ms = 3000;
+module_param(timeout_ms,uint,0444);
+MODULE_PARM_DESC(timeout_ms,"Timeout of a transfer (ms)");
+
+enum dma_bench_mode {
+	DMA_BENCH_SG,
+	DMA_BENCH_CYCLIC,
+	DMA_BENCH_MEMCPY,
+	DMA_BENCH_PDESC,
+};
+
+/* Measured stages of a transfer */
+enum dma_bench_stage {
+	DMA_BENCH_SETUP,
+	DMA_BENCH_MAP,
+	DMA_BENCH_PREP,
+	DMA_BENCH_SUBMIT,
+	DMA_BENCH_COMPLETE,
+	DMA_BENCH_NSTAGES,
+};
+
+static const char * const dma_bench_stage_names[] = {
+	"setup", "map", "prep", "submit", "complete",
+};
+
+/* A transfer in flight (one slot of the window of a thread) */
+struct dma_bench_req {
+	struct dma_bench_thread * t;
+
+	/* Buffers (allocated once) */
+	void * buf;
+	struct dma_block * block;
+	void * cpu_src;
+	void * cpu_dst;
+	dma_addr_t dma_src;
+	dma_addr_t dma_dst;
+
+	/* Transfer in flight */
+	struct dma_sg * sg;
+	struct dma_xfer * xfer;
+	struct pdesc * pdesc;
+	u64 t_submit;
+	u64 t_done;
+};
+
+struct dma_bench_thread {
+	struct task_struct * task;
+	struct dma_chan * chan;
+	int own_chan;
+
+	struct dma_bench_req * reqs;
+
+	/* Latencies (ns) of each stage */
+	u64 * lat[DMA_BENCH_NSTAGES];
+	unsigned int n;
+
+	unsigned long allocs;
+	u64 bytes;
+	int result;
+
+	/* Signaled when the run is over (the thread is reaped after it) */
+	struct completion done;
+
+	/* Cyclic mode: periods seen by the DMA callback */
+	unsigned int periods;
+	u64 prev;
+	struct completion cyclic_done;
+};
+
+static enum dma_bench_mode dma_bench_mode;
+static struct dma_bench_thread * dma_bench_threads;
+static unsigned int dma_bench_nthreads;
+
+static u64 _dma_bench_now(void)
+{
+	return ktime_get_ns();
+}
+
+static int _dma_bench_thread(void * data);
+
+/*
+ * Allocations made by the benchmark threads. It runs on every
+ * allocation of the system, so the other tasks are rejected first.
+ */
+static void _dma_bench_count_alloc(void)
+{
+	unsigned int i;
+
+	if(!(current->flags & PF_KTHREAD) || \
+		kthread_func(current) != _dma_bench_thread)
+		return;
+
+	for(i = 0; i < dma_bench_nthreads; i++) {
+		if(dma_bench_threads[i].task == current) {
+			dma_bench_threads[i].allocs++;
+			break;
+		}
+	}
+}
+
+static void _dma_bench_kmalloc(void * data, unsigned long call_site, \
+	const void * ptr, size_t bytes_req, size_t bytes_alloc, \
+	gfp_t gfp_flags, int node)
+{
+	_dma_bench_count_alloc();
+}
+
+static void _dma_bench_kmem_cache_alloc(void * data, \
+	unsigned long call_site, const void * ptr, struct kmem_cache * s, \
+	gfp_t gfp_flags, int node)
+{
+	_dma_bench_count_alloc();
+}
+
+static void _dma_bench_callback(void * param)
+{
+	struct dma_bench_req * req = param;
+
+	WRITE_ONCE(req->t_done,_dma_bench_now());
+}
+
+static void _dma_bench_cyclic_callback(void * param)
+{
+	struct dma_bench_thread * t = param;
+	u64 now = _dma_bench_now();
+
+	if(t->periods < iterations) {
+		t->lat[DMA_BENCH_COMPLETE][t->periods] = now-t->prev;
+		t->bytes += size;
+		if(++t->periods == iterations)
+			complete(&t->cyclic_done);
+	}
+
+	t->prev = now;
+}
+
+static bool _dma_bench_filter(struct dma_chan * chan, void * param)
+{
+	return dev[0] == '\0' || strcmp(dev_name(chan->device->dev),dev) == 0;
+}
+
+static struct dma_chan * _dma_bench_request_chan(void)
+{
+	dma_cap_mask_t mask;
+
+	dma_cap_zero(mask);
+	switch(dma_bench_mode) {
+	case DMA_BENCH_MEMCPY:
+		dma_cap_set(DMA_MEMCPY,mask);
+		break;
+	case DMA_BENCH_CYCLIC:
+		dma_cap_set(DMA_CYCLIC,mask);
+		break;
+	default:
+		dma_cap_set(DMA_SLAVE,mask);
+		break;
+	}
+
+	return dma_request_channel(mask,_dma_bench_filter,NULL);
+}
+
+static struct device * _dma_bench_dev(struct dma_bench_thread * t)
+{
+	return t->chan->device->dev;
+}
+
+static int _dma_bench_alloc_buf(struct dma_bench_thread * t, \
+	struct dma_bench_req * req)
+{
+	struct device * hwdev = _dma_bench_dev(t);
+
+	if(dma_bench_mode == DMA_BENCH_MEMCPY) {
+		req->cpu_src = dma_alloc_coherent(hwdev,size,&req->dma_src, \
+			GFP_KERNEL);
+		req->cpu_dst = dma_alloc_coherent(hwdev,size,&req->dma_dst, \
+			GFP_KERNEL);
+		return (req->cpu_src != NULL && req->cpu_dst != NULL) ? 0 : -1;
+	}
+
+	if(strcmp(shape,"vmalloc") == 0) {
+		req->buf = vzalloc(size);
+		if(req->buf != NULL)
+			req->block = simple_dma_block_create(req->buf,size, \
+				GFP_KERNEL);
+	} else if(strcmp(shape,"offset") == 0) {
+		req->buf = kzalloc(size+offset,GFP_KERNEL);
+		if(req->buf != NULL)
+			req->block = simple_dma_block_create(req->buf+offset, \
+				size,GFP_KERNEL);
+	} else {
+		req->buf = kzalloc(size,GFP_KERNEL);
+		if(req->buf != NULL)
+			req->block = simple_dma_block_create(req->buf,size, \
+				GFP_KERNEL);
+	}
+
+	return (req->block != NULL) ? 0 : -1;
+}
+
+static void _dma_bench_free_buf(struct dma_bench_thread * t, \
+	struct dma_bench_req * req)
+{
+	struct device * hwdev = _dma_bench_dev(t);
+
+	if(req->cpu_src != NULL)
+		dma_free_coherent(hwdev,size,req->cpu_src,req->dma_src);
+	if(req->cpu_dst != NULL)
+		dma_free_coherent(hwdev,size,req->cpu_dst,req->dma_dst);
+
+	if(req->block != NULL)
+		simple_dma_block_free(req->block);
+	kvfree(req->buf);
+}
+
+static void _dma_bench_record(struct dma_bench_thread * t, \
+	enum dma_bench_stage stage, u64 ns)
+{
+	t->lat[stage][t->n] = ns;
+}
+
+/* Start a transfer in a free slot */
+static int _dma_bench_start(struct dma_bench_thread * t, \
+	struct dma_bench_req * req)
+{
+	struct device * hwdev = _dma_bench_dev(t);
+	struct dma_slave_config config = { };
+	struct dma_memcpy_info info;
+	enum dma_transfer_direction dir = tx ? DMA_MEM_TO_DEV : DMA_DEV_TO_MEM;
+	unsigned long flags = DMA_PREP_INTERRUPT | DMA_CTRL_ACK;
+	u64 t0, t1, t2, t3;
+	int r;
+
+	config.direction = dir;
+
+	req->t_done = 0;
+	t0 = _dma_bench_now();
+
+	if(dma_bench_mode == DMA_BENCH_PDESC) {
+		req->pdesc = pdesc_create(t->chan,req->block, \
+			tx ? PDESC_TX : PDESC_RX,0,hwdev,GFP_KERNEL);
+		if(req->pdesc == NULL)
+			return -1;
+		t1 = _dma_bench_now();
+
+		r = pdesc_xfer_prep(req->pdesc,_dma_bench_callback,req, \
+			flags,NULL,GFP_KERNEL);
+		t2 = _dma_bench_now();
+		if(r != 0)
+			return -1;
+
+		req->xfer = list_first_entry(&req->pdesc->dma_op->list_dma_xfer, \
+			struct dma_xfer,node);
+	} else {
+		req->xfer = dma_xfer_create(t->chan,&config,hwdev,GFP_KERNEL);
+		if(req->xfer == NULL)
+			return -1;
+
+		if(dma_bench_mode == DMA_BENCH_MEMCPY) {
+			info.src = req->dma_src;
+			info.dst = req->dma_dst;
+			info.len = size;
+			dma_xfer_memcpy_setup(req->xfer,&info);
+			t1 = _dma_bench_now();
+			t2 = t1;
+
+			r = dma_xfer_prep_start_memcpy(req->xfer, \
+				_dma_bench_callback,req,flags);
+		} else {
+			req->sg = dma_sg_create(req->block,GFP_KERNEL);
+			if(req->sg == NULL)
+				return -1;
+
+			dma_xfer_add_sg(req->xfer,req->sg);
+			t1 = _dma_bench_now();
+
+			r = dma_xfer_map_sg(req->xfer, \
+				tx ? DMA_TO_DEVICE : DMA_FROM_DEVICE,GFP_KERNEL);
+			t2 = _dma_bench_now();
+
+			if(r == 0)
+				r = dma_xfer_prep_start_sg(req->xfer,dir, \
+					_dma_bench_callback,req,flags,NULL);
+		}
+	}
+
+	if(r != 0)
+		return -1;
+
+	t3 = _dma_bench_now();
+
+	req->t_submit = t3;
+	r = dma_xfer_start(req->xfer);
+
+	_dma_bench_record(t,DMA_BENCH_SETUP,t1-t0);
+	_dma_bench_record(t,DMA_BENCH_MAP,t2-t1);
+	_dma_bench_record(t,DMA_BENCH_PREP,t3-t2);
+	_dma_bench_record(t,DMA_BENCH_SUBMIT,_dma_bench_now()-t3);
+
+	return r;
+}
+
+static void _dma_bench_release(struct dma_bench_req * req)
+{
+	if(req->pdesc != NULL) {
+		pdesc_free(req->pdesc);
+	} else if(req->xfer != NULL) {
+		dma_xfer_clear_sg(req->xfer);
+		dma_xfer_free(req->xfer);
+		dma_sg_free(req->sg);
+	}
+
+	req->pdesc = NULL;
+	req->xfer = NULL;
+	req->sg = NULL;
+}
+
+/* Wait for the transfer of a slot and release it */
+static int _dma_bench_complete(struct dma_bench_thread * t, \
+	struct dma_bench_req * req, unsigned int i)
+{
+	int r;
+
+	r = dma_xfer_wait(req->xfer,0,msecs_to_jiffies(timeout_ms));
+	if(r == -2) {
+		/* The callback may still come: stop the channel */
+		dmaengine_terminate_sync(t->chan);
+	} else if(r == 0) {
+		/* The DMA callback runs just after the completion */
+		while(READ_ONCE(req->t_done) == 0)
+			cpu_relax();
+		t->lat[DMA_BENCH_COMPLETE][i] = req->t_done-req->t_submit;
+		t->bytes += size;
+	}
+
+	_dma_bench_release(req);
+
+	return r;
+}
+
+static int _dma_bench_run_window(struct dma_bench_thread * t)
+{
+	struct dma_bench_req * req;
+	unsigned int slot;
+	unsigned int i;
+	int r = 0;
+
+	for(i = 0; i < iterations+depth; i++) {
+		slot = i % depth;
+		req = &t->reqs[slot];
+
+		/* The slot is reused: the oldest transfer must complete */
+		if(i >= depth) {
+			r = _dma_bench_complete(t,req,i-depth);
+			if(r != 0)
+				break;
+		}
+
+		if(i < iterations) {
+			t->n = i;
+			r = _dma_bench_start(t,req);
+			if(r != 0) {
+				_dma_bench_release(req);
+				break;
+			}
+		}
+	}
+
+	/* Drain the window on error */
+	for(slot = 0; slot < depth; slot++)
+		if(t->reqs[slot].xfer != NULL)
+			_dma_bench_complete(t,&t->reqs[slot],0);
+
+	return r;
+}
+
+/* Cyclic mode: one transfer, the periods are the samples */
+static int _dma_bench_run_cyclic(struct dma_bench_thread * t)
+{
+	struct device * hwdev = _dma_bench_dev(t);
+	struct dma_slave_config config = { };
+	struct dma_cyclic_info info;
+	struct dma_xfer * xfer;
+	void * vaddr;
+	u64 t0, t1;
+	int r = -1;
+
+	config.direction = tx ? DMA_MEM_TO_DEV : DMA_DEV_TO_MEM;
+
+	vaddr = dma_alloc_coherent(hwdev,(size_t) size*depth,&info.dma_addr, \
+		GFP_KERNEL);
+	if(vaddr == NULL)
+		return -1;
+
+	t0 = _dma_bench_now();
+	xfer = dma_xfer_create(t->chan,&config,hwdev,GFP_KERNEL);
+	if(xfer == NULL)
+		goto out;
+
+	info.len = (size_t) size*depth;
+	info.period_len = size;
+	dma_xfer_cyclic_setup(xfer,&info);
+	t1 = _dma_bench_now();
+
+	if(dma_xfer_prep_start_cyclic(xfer,config.direction, \
+		_dma_bench_cyclic_callback,t,DMA_PREP_INTERRUPT) != 0)
+		goto out_xfer;
+
+	t->n = 0;
+	_dma_bench_record(t,DMA_BENCH_SETUP,t1-t0);
+	_dma_bench_record(t,DMA_BENCH_MAP,0);
+	_dma_bench_record(t,DMA_BENCH_PREP,_dma_bench_now()-t1);
+
+	init_completion(&t->cyclic_done);
+	t->periods = 0;
+	t->prev = _dma_bench_now();
+	dma_xfer_start(xfer);
+	_dma_bench_record(t,DMA_BENCH_SUBMIT,_dma_bench_now()-t->prev);
+
+	/* The samples are the intervals between periods */
+	if(wait_for_completion_timeout(&t->cyclic_done, \
+		msecs_to_jiffies(timeout_ms)+ \
+		msecs_to_jiffies(iterations)) > 0)
+		r = 0;
+
+	dmaengine_terminate_sync(t->chan);
+
+out_xfer:
+	dma_xfer_free(xfer);
+out:
+	dma_free_coherent(hwdev,(size_t) size*depth,vaddr,info.dma_addr);
+
+	return r;
+}
+
+static int _dma_bench_thread(void * data)
+{
+	struct dma_bench_thread * t = data;
+	unsigned int i;
+
+	for(i = 0; i < depth; i++) {
+		t->reqs[i].t = t;
+		if(_dma_bench_alloc_buf(t,&t->reqs[i]) != 0) {
+			t->result = -ENOMEM;
+			goto out;
+		}
+	}
+
+	t->allocs = 0;
+
+	if(dma_bench_mode == DMA_BENCH_CYCLIC)
+		t->result = _dma_bench_run_cyclic(t);
+	else
+		t->result = _dma_bench_run_window(t);
+
+out:
+	for(i = 0; i < depth; i++)
+		_dma_bench_free_buf(t,&t->reqs[i]);
+
+	complete(&t->done);
+
+	return 0;
+}
+
+static int _dma_bench_cmp(const void * a, const void * b)
+{
+	u64 x = *(const u64 *) a;
+	u64 y = *(const u64 *) b;
+
+	return (x > y)-(x < y);
+}
+
+static void _dma_bench_report_stage(enum dma_bench_stage stage, u64 * all)
+{
+	unsigned int n = 0;
+	unsigned int i;
+	unsigned int j;
+	unsigned int samples;
+
+	for(i = 0; i < dma_bench_nthreads; i++) {
+		samples = (dma_bench_mode == DMA_BENCH_CYCLIC && \
+			stage != DMA_BENCH_COMPLETE) ? 1 : iterations;
+		for(j = 0; j < samples; j++)
+			all[n++] = dma_bench_threads[i].lat[stage][j];
+	}
+
+	sort(all,n,sizeof(*all),_dma_bench_cmp,NULL);
+
+	pr_info("dma_bench: %-8s p50 %llu p90 %llu p99 %llu max %llu ns\n", \
+		dma_bench_stage_names[stage],all[n/2],all[(n*9)/10], \
+		all[(n*99)/100],all[n-1]);
+}
+
+static void _dma_bench_report(u64 elapsed)
+{
+	unsigned long allocs = 0;
+	u64 bytes = 0;
+	u64 * all;
+	unsigned int i;
+
+	for(i = 0; i < dma_bench_nthreads; i++) {
+		if(dma_bench_threads[i].result != 0) {
+			pr_err("dma_bench: thread %u failed (%d)\n",i, \
+				dma_bench_threads[i].result);
+			return;
+		}
+
+		allocs += dma_bench_threads[i].allocs;
+		bytes += dma_bench_threads[i].bytes;
+	}
+
+	pr_info("dma_bench: mode %s size %u shape %s depth %u threads %u\n", \
+		mode,size,shape,depth,dma_bench_nthreads);
+	pr_info("dma_bench: %llu MB/s, %lu.%02lu allocs/xfer\n", \
+		div64_u64(bytes*1000,max_t(u64,elapsed,1)), \
+		allocs/(iterations*dma_bench_nthreads), \
+		(allocs*100/(iterations*dma_bench_nthreads)) % 100);
+
+	all = vmalloc(array_size(dma_bench_nthreads*iterations,sizeof(*all)));
+	if(all == NULL)
+		return;
+
+	for(i = 0; i < DMA_BENCH_NSTAGES; i++)
+		_dma_bench_report_stage(i,all);
+
+	vfree(all);
+}
+
+static int _dma_bench_parse_mode(void)
+{
+	if(strcmp(mode,"sg") == 0)
+		dma_bench_mode = DMA_BENCH_SG;
+	else if(strcmp(mode,"cyclic") == 0)
+		dma_bench_mode = DMA_BENCH_CYCLIC;
+	else if(strcmp(mode,"memcpy") == 0)
+		dma_bench_mode = DMA_BENCH_MEMCPY;
+	else if(strcmp(mode,"pdesc") == 0)
+		dma_bench_mode = DMA_BENCH_PDESC;
+	else
+		return -EINVAL;
+
+	return 0;
+}
+
+static void _dma_bench_free_threads(void)
+{
+	struct dma_bench_thread * t;
+	unsigned int i;
+	unsigned int j;
+
+	for(i = 0; i < dma_bench_nthreads; i++) {
+		t = &dma_bench_threads[i];
+
+		for(j = 0; j < DMA_BENCH_NSTAGES; j++)
+			vfree(t->lat[j]);
+		kfree(t->reqs);
+
+		if(t->own_chan)
+			dma_release_channel(t->chan);
+	}
+
+	kfree(dma_bench_threads);
+	dma_bench_threads = NULL;
+	dma_bench_nthreads = 0;
+}
+
+static int _dma_bench_alloc_threads(void)
+{
+	struct dma_bench_thread * t;
+	unsigned int i;
+	unsigned int j;
+
+	dma_bench_threads = kcalloc(threads,sizeof(*dma_bench_threads), \
+		GFP_KERNEL);
+	if(dma_bench_threads == NULL)
+		return -ENOMEM;
+
+	for(i = 0; i < threads; i++) {
+		t = &dma_bench_threads[i];
+		dma_bench_nthreads++;
+		init_completion(&t->done);
+
+		/* The threads share the channels if there are not enough */
+		t->chan = _dma_bench_request_chan();
+		t->own_chan = (t->chan != NULL);
+		if(t->chan == NULL && i > 0 && dma_bench_mode != DMA_BENCH_CYCLIC)
+			t->chan = dma_bench_threads[i-1].chan;
+		if(t->chan == NULL)
+			return -ENODEV;
+
+		t->reqs = kcalloc(depth,sizeof(*t->reqs),GFP_KERNEL);
+		if(t->reqs == NULL)
+			return -ENOMEM;
+
+		for(j = 0; j < DMA_BENCH_NSTAGES; j++) {
+			t->lat[j] = vzalloc(array_size(iterations,sizeof(u64)));
+			if(t->lat[j] == NULL)
+				return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+static int __init dma_bench_init(void)
+{
+	u64 start;
+	unsigned int i;
+	int r;
+
+	if(_dma_bench_parse_mode() != 0 || size == 0 || depth == 0 || \
+		threads == 0 || threads > DMA_BENCH_MAX_THREADS || iterations == 0)
+		return -EINVAL;
+
+	r = _dma_bench_alloc_threads();
+	if(r != 0)
+		goto out;
+
+	r = register_trace_kmalloc(_dma_bench_kmalloc,NULL);
+	if(r == 0)
+		r = register_trace_kmem_cache_alloc(_dma_bench_kmem_cache_alloc, \
+			NULL);
+	if(r != 0) {
+		pr_warn("dma_bench: allocations are not counted\n");
+		r = 0;
+	}
+
+	for(i = 0; i < dma_bench_nthreads; i++) {
+		dma_bench_threads[i].task = kthread_create(_dma_bench_thread, \
+			&dma_bench_threads[i],"dma_bench/%u",i);
+		if(IS_ERR(dma_bench_threads[i].task)) {
+			r = PTR_ERR(dma_bench_threads[i].task);
+			dma_bench_threads[i].task = NULL;
+			break;
+		}
+		get_task_struct(dma_bench_threads[i].task);
+	}
+
+	/*
+	 * The threads only run if all of them have been created: a thread
+	 * that is stopped before its first wake up never runs its function.
+	 */
+	start = ktime_get_ns();
+	if(r == 0) {
+		for(i = 0; i < dma_bench_nthreads; i++)
+			wake_up_process(dma_bench_threads[i].task);
+
+		for(i = 0; i < dma_bench_nthreads; i++)
+			wait_for_completion(&dma_bench_threads[i].done);
+	}
+
+	for(i = 0; i < dma_bench_nthreads; i++) {
+		if(dma_bench_threads[i].task != NULL) {
+			kthread_stop(dma_bench_threads[i].task);
+			put_task_struct(dma_bench_threads[i].task);
+		}
+	}
+
+	unregister_trace_kmem_cache_alloc(_dma_bench_kmem_cache_alloc,NULL);
+	unregister_trace_kmalloc(_dma_bench_kmalloc,NULL);
+	tracepoint_synchronize_unregister();
+
+	if(r == 0)
+		_dma_bench_report(ktime_get_ns()-start);
+
+out:
+	_dma_bench_free_threads();
+
+	return r;
+}
+
+static void __exit dma_bench_exit(void)
+{
+}
+
+module_init(dma_bench_init);
+module_exit(dma_bench_exit);
+
+MODULE_AUTHOR("Miguel Jimenez Lopez <klyone@ugr.es>");
+MODULE_DESCRIPTION("DMA Operation Layer benchmark");
+MODULE_LICENSE("GPL v2");
@@ -9,6 +9,8 @@
 */
 
 #include <linux/slab.h>
+#include <linux/mm.h>
+#include <asm/page.h>
 
 #include "dma_block.h"
 
@@ -45,6 +47,370 @@ size_t dma_block_get_size(struct dma_block * block)
 	return block->op->get_size(block);
 }
 
+struct page ** dma_block_get_pages(struct dma_block * block, \
+	unsigned int * npages, unsigned int * offset)
+{
+	if(block->op->get_pages == NULL)
+		return NULL;
+
+	return block->op->get_pages(block,npages,offset);
+}
+
+struct sg_table * dma_block_get_dma_sg_table(struct dma_block * block, \
+	struct device * dev, enum dma_data_direction dir)
+{
+	if(block->op->get_dma_sg_table == NULL)
+		return NULL;
+
+	return block->op->get_dma_sg_table(block,dev,dir);
+}
+
+/*
+ * Size of a segment that starts at phys: it must not cross a segment
+ * boundary of the device. As in blk_rq_map_sg, the physical address
+ * stands for the DMA address (an IOMMU applies the boundary itself).
+ */
+static size_t _dma_block_seg_limit(phys_addr_t phys, unsigned int max_seg, \
+	unsigned long seg_boundary)
+{
+	unsigned long left = seg_boundary & ~((unsigned long) phys);
+
+	return (left >= max_seg) ? max_seg : (size_t) left+1;
+}
+
+static size_t _dma_block_table_next_seg(struct scatterlist * s, \
+	size_t skip, unsigned int max_seg, unsigned long seg_boundary, \
+	struct page ** page, unsigned int * off)
+{
+	size_t pos = s->offset+skip;
+
+	*page = nth_page(sg_page(s),pos >> PAGE_SHIFT);
+	*off = offset_in_page(pos);
+
+	return min(s->length-skip,_dma_block_seg_limit(page_to_phys(*page) + \
+		*off,max_seg,seg_boundary));
+}
+
+static int _dma_block_table_get_sg_nents(struct sg_table * sgt, \
+	size_t offset, size_t len, unsigned int max_seg, \
+	unsigned long seg_boundary)
+{
+	struct scatterlist * s;
+	struct page * page;
+	unsigned int off;
+	size_t mapbytes;
+	int nents = 0;
+	int i;
+
+	for_each_sg(sgt->sgl,s,sgt->orig_nents,i) {
+		if(len == 0)
+			break;
+
+		if(offset >= s->length) {
+			offset -= s->length;
+			continue;
+		}
+
+		while(len && offset < s->length) {
+			mapbytes = _dma_block_table_next_seg(s,offset,max_seg, \
+				seg_boundary,&page,&off);
+			mapbytes = min(mapbytes,len);
+
+			offset += mapbytes;
+			len -= mapbytes;
+			nents++;
+		}
+
+		offset = 0;
+	}
+
+	return nents;
+}
+
+static int _dma_block_table_setup_sg(struct sg_table * sgt, \
+	size_t offset, size_t len, unsigned int max_seg, \
+	unsigned long seg_boundary, struct scatterlist ** sg, int nents)
+{
+	struct scatterlist * s;
+	struct page * page;
+	unsigned int off;
+	size_t mapbytes;
+	int n = 0;
+	int i;
+
+	for_each_sg(sgt->sgl,s,sgt->orig_nents,i) {
+		if(len == 0 || n == nents)
+			break;
+
+		if(offset >= s->length) {
+			offset -= s->length;
+			continue;
+		}
+
+		while(len && offset < s->length && n < nents) {
+			mapbytes = _dma_block_table_next_seg(s,offset,max_seg, \
+				seg_boundary,&page,&off);
+			mapbytes = min(mapbytes,len);
+
+			sg_set_page(*sg,page,mapbytes,off);
+
+			offset += mapbytes;
+			len -= mapbytes;
+
+			*sg = sg_next(*sg);
+			n++;
+		}
+
+		offset = 0;
+	}
+
+	return n;
+}
+
+/*
+ * Pages that are physically contiguous (e.g. the pages of a THP,
+ * hugetlbfs or high-order folio) are merged in the same segment.
+ */
+static size_t _dma_block_pages_next_seg(struct page ** pages, \
+	size_t pos, size_t bytesleft, unsigned int max_seg, \
+	unsigned long seg_boundary)
+{
+	size_t idx = pos >> PAGE_SHIFT;
+	unsigned long pfn = page_to_pfn(pages[idx]);
+	size_t mapbytes = PAGE_SIZE-offset_in_page(pos);
+	size_t limit;
+
+	limit = _dma_block_seg_limit(page_to_phys(pages[idx]) + \
+		offset_in_page(pos),max_seg,seg_boundary);
+
+	while(mapbytes < bytesleft && mapbytes < limit && \
+		page_to_pfn(pages[idx+1]) == pfn+1) {
+		idx++;
+		pfn++;
+		mapbytes += PAGE_SIZE;
+	}
+
+	return min3(mapbytes,bytesleft,limit);
+}
+
+static int _dma_block_pages_get_sg_nents(struct page ** pages, \
+	unsigned int pgoff, size_t offset, size_t len, unsigned int max_seg, \
+	unsigned long seg_boundary)
+{
+	size_t pos = pgoff+offset;
+	size_t bytesleft = len;
+	size_t mapbytes;
+	int nents = 0;
+
+	while(bytesleft) {
+		mapbytes = _dma_block_pages_next_seg(pages,pos,bytesleft, \
+			max_seg,seg_boundary);
+
+		pos += mapbytes;
+		bytesleft -= mapbytes;
+		nents++;
+	}
+
+	return nents;
+}
+
+static int _dma_block_pages_setup_sg(struct page ** pages, \
+	unsigned int pgoff, size_t offset, size_t len, unsigned int max_seg, \
+	unsigned long seg_boundary, struct scatterlist ** sg, int nents)
+{
+	size_t pos = pgoff+offset;
+	size_t bytesleft = len;
+	size_t mapbytes;
+	int n = 0;
+
+	while(bytesleft && n < nents) {
+		mapbytes = _dma_block_pages_next_seg(pages,pos,bytesleft, \
+			max_seg,seg_boundary);
+
+		sg_set_page(*sg,pages[pos >> PAGE_SHIFT],mapbytes, \
+			offset_in_page(pos));
+
+		pos += mapbytes;
+		bytesleft -= mapbytes;
+
+		*sg = sg_next(*sg);
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * The linear mapping is physically contiguous, so a lowmem buffer
+ * (kmalloc, high-order alloc_pages, folios...) is described with
+ * segments of the maximum size. vmalloc buffers are walked page by
+ * page, merging the pages that are physically contiguous.
+ */
+static size_t _dma_block_buffer_next_seg(void * bufp, size_t bytesleft, \
+	unsigned int max_seg, unsigned long seg_boundary, struct page ** page)
+{
+	unsigned long pfn;
+	size_t mapbytes;
+	size_t limit;
+
+	if(!is_vmalloc_addr(bufp)) {
+		*page = virt_to_page(bufp);
+		limit = _dma_block_seg_limit(page_to_phys(*page) + \
+			offset_in_page(bufp),max_seg,seg_boundary);
+
+		return min(bytesleft,limit);
+	}
+
+	*page = vmalloc_to_page(bufp);
+	pfn = page_to_pfn(*page);
+	mapbytes = PAGE_SIZE-offset_in_page(bufp);
+	limit = _dma_block_seg_limit(page_to_phys(*page) + \
+		offset_in_page(bufp),max_seg,seg_boundary);
+
+	while(mapbytes < bytesleft && mapbytes < limit && \
+		page_to_pfn(vmalloc_to_page(bufp+mapbytes)) == pfn+1) {
+		pfn++;
+		mapbytes += PAGE_SIZE;
+	}
+
+	return min3(mapbytes,bytesleft,limit);
+}
+
+/* This function is inspired by zio_calculate_nents (dma.c) of
+ * the ZIO project (http://www.ohwr.org/projects/zio).
+ */
+static int _dma_block_buffer_get_sg_nents(struct dma_block * block, \
+	size_t offset, size_t len, unsigned int max_seg, \
+	unsigned long seg_boundary)
+{
+	void * bufp;
+	size_t bytesleft;
+	size_t mapbytes;
+	struct page * page;
+	int nents = 0;
+
+	bufp = dma_block_get_buffer(block)+offset;
+	bytesleft = len;
+
+	while(bytesleft) {
+		nents++;
+
+		mapbytes = _dma_block_buffer_next_seg(bufp,bytesleft,max_seg, \
+			seg_boundary,&page);
+
+		bufp += mapbytes;
+		bytesleft -= mapbytes;
+	}
+
+	return nents;
+}
+
+/* This function is inspired by zio_dma_setup_scatter (dma.c) of
+ * the ZIO project (http://www.ohwr.org/projects/zio).
+ */
+static int _dma_block_buffer_setup_sg(struct dma_block * block, \
+	size_t offset, size_t len, unsigned int max_seg, \
+	unsigned long seg_boundary, struct scatterlist ** sg, int nents)
+{
+	void * bufp;
+	size_t bytesleft;
+	size_t mapbytes;
+	struct page * page;
+	int n = 0;
+
+	bufp = dma_block_get_buffer(block)+offset;
+	bytesleft = len;
+
+	while(bytesleft && n < nents) {
+		mapbytes = _dma_block_buffer_next_seg(bufp,bytesleft,max_seg, \
+			seg_boundary,&page);
+
+		sg_set_page(*sg,page,mapbytes,offset_in_page(bufp));
+
+		bufp += mapbytes;
+		bytesleft -= mapbytes;
+
+		*sg = sg_next(*sg);
+		n++;
+	}
+
+	return n;
+}
+
+static int _dma_block_check_range(struct dma_block * block, \
+	size_t offset, size_t len, unsigned int max_seg)
+{
+	size_t size = dma_block_get_size(block);
+
+	if(offset > size || len > size-offset || max_seg == 0)
+		return -1;
+
+	return 0;
+}
+
+int dma_block_get_sg_nents(struct dma_block * block, size_t offset, \
+	size_t len, unsigned int max_seg, unsigned long seg_boundary)
+{
+	struct sg_table * sgt;
+	struct page ** pages;
+	unsigned int npages;
+	unsigned int pgoff;
+
+	if(_dma_block_check_range(block,offset,len,max_seg) < 0)
+		return -1;
+
+	if(block->op->get_sg_nents != NULL)
+		return block->op->get_sg_nents(block,offset,len,max_seg, \
+			seg_boundary);
+
+	if(block->op->get_sg_table != NULL) {
+		sgt = block->op->get_sg_table(block);
+		if(sgt != NULL)
+			return _dma_block_table_get_sg_nents(sgt,offset,len, \
+				max_seg,seg_boundary);
+	}
+
+	pages = dma_block_get_pages(block,&npages,&pgoff);
+	if(pages != NULL)
+		return _dma_block_pages_get_sg_nents(pages,pgoff,offset, \
+			len,max_seg,seg_boundary);
+
+	return _dma_block_buffer_get_sg_nents(block,offset,len,max_seg, \
+		seg_boundary);
+}
+
+int dma_block_setup_sg(struct dma_block * block, size_t offset, \
+	size_t len, unsigned int max_seg, unsigned long seg_boundary, \
+	struct scatterlist ** sg, int nents)
+{
+	struct sg_table * sgt;
+	struct page ** pages;
+	unsigned int npages;
+	unsigned int pgoff;
+
+	if(_dma_block_check_range(block,offset,len,max_seg) < 0)
+		return -1;
+
+	if(block->op->setup_sg != NULL)
+		return block->op->setup_sg(block,offset,len,max_seg, \
+			seg_boundary,sg,nents);
+
+	if(block->op->get_sg_table != NULL) {
+		sgt = block->op->get_sg_table(block);
+		if(sgt != NULL)
+			return _dma_block_table_setup_sg(sgt,offset,len, \
+				max_seg,seg_boundary,sg,nents);
+	}
+
+	pages = dma_block_get_pages(block,&npages,&pgoff);
+	if(pages != NULL)
+		return _dma_block_pages_setup_sg(pages,pgoff,offset,len, \
+			max_seg,seg_boundary,sg,nents);
+
+	return _dma_block_buffer_setup_sg(block,offset,len,max_seg, \
+		seg_boundary,sg,nents);
+}
+
 void dma_block_free(struct dma_block * block) {
 	if(block != NULL) {
 		if(block->priv != NULL)
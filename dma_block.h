@@ -12,8 +12,12 @@
 #define DMA_BLOCK_H
 
 #include <linux/types.h>
+#include <linux/scatterlist.h>
+#include <linux/dma-direction.h>
 
 struct dma_block;
+struct page;
+struct device;
 
 /**
  * 
@@ -29,10 +33,72 @@ struct dma_block;
  * 
  * 		Return: Block size.
  * 
+ * get_pages: Get the page array that backs the data block (optional).
+ * 		@block: Block pointer.
+ * 		@npages: Number of pages of the array.
+ * 		@offset: Offset of the data within the first page.
+ * 
+ * 		Return: Page array or NULL if the block has no page array.
+ * 
+ * get_sg_table: Get a (not DMA mapped) SG table that describes the
+ * 		data block (optional).
+ * 		@block: Block pointer.
+ * 
+ * 		Return: SG table or NULL if the block has no SG table.
+ * 
+ * get_sg_nents: Get the number of SG entries needed to describe a
+ * 		range of the data block (optional, see setup_sg).
+ * 		@block: Block pointer.
+ * 		@offset: Offset within the data block.
+ * 		@len: Length of the range.
+ * 		@max_seg: Maximum size of a SG entry.
+ * 		@seg_boundary: Segment boundary mask of the device.
+ * 
+ * 		Return: Number of SG entries or a negative value on error.
+ * 
+ * setup_sg: Fill the SG entries that describe a range of the data
+ * 		block (optional, it must be provided with get_sg_nents).
+ * 		@block: Block pointer.
+ * 		@offset: Offset within the data block.
+ * 		@len: Length of the range.
+ * 		@max_seg: Maximum size of a SG entry.
+ * 		@seg_boundary: Segment boundary mask of the device.
+ * 		@sg: First SG entry to fill. It is updated to the next
+ * 			free entry.
+ * 		@nents: Number of free SG entries.
+ * 
+ * 		Return: Number of SG entries filled or a negative value
+ * 		on error.
+ * 
+ * get_dma_sg_table: Get an SG table that is already DMA mapped for a
+ * 		device (optional). The table is used as it is by the transfer
+ * 		and it is not mapped/unmapped again.
+ * 		@block: Block pointer.
+ * 		@dev: Device that performs the DMA transfer.
+ * 		@dir: DMA direction.
+ * 
+ * 		Return: SG table or NULL if the block has no mapped SG table
+ * 		for the device and direction.
+ * 
+ * The optional methods are a fast path to build the SG table of a
+ * transfer: setup_sg/get_sg_nents are used first, then get_sg_table,
+ * then get_pages and, if none of them is provided, the buffer returned
+ * by get_buffer is walked page by page.
+ * 
  */
 struct dma_block_op {
 	void * (*get_buffer)(struct dma_block * block);
 	size_t (*get_size)(struct dma_block * block);
+	struct page ** (*get_pages)(struct dma_block * block, \
+		unsigned int * npages, unsigned int * offset);
+	struct sg_table * (*get_sg_table)(struct dma_block * block);
+	int (*get_sg_nents)(struct dma_block * block, size_t offset, \
+		size_t len, unsigned int max_seg, unsigned long seg_boundary);
+	int (*setup_sg)(struct dma_block * block, size_t offset, \
+		size_t len, unsigned int max_seg, unsigned long seg_boundary, \
+		struct scatterlist ** sg, int nents);
+	struct sg_table * (*get_dma_sg_table)(struct dma_block * block, \
+		struct device * dev, enum dma_data_direction dir);
 };
 
 /**
@@ -94,6 +160,70 @@ void * dma_block_get_buffer(struct dma_block * block);
  * Return: The size of the DMA Block.
  */
 size_t dma_block_get_size(struct dma_block * block);
+
+/**
+ * dma_block_get_pages - Get the page array that backs the
+ * DMA block.
+ *
+ * @block: DMA Block.
+ * @npages: Number of pages of the array.
+ * @offset: Offset of the data within the first page.
+ *
+ * Return: The page array or NULL if the block is not backed
+ * by a page array (i.e. it only provides a kernel buffer).
+ */
+struct page ** dma_block_get_pages(struct dma_block * block, \
+	unsigned int * npages, unsigned int * offset);
+
+/**
+ * dma_block_get_dma_sg_table - Get the SG table of the DMA block
+ * that is already DMA mapped for a device.
+ *
+ * @block: DMA Block.
+ * @dev: Device that performs the DMA transfer.
+ * @dir: DMA direction.
+ *
+ * Return: The mapped SG table or NULL if the block does not provide it.
+ */
+struct sg_table * dma_block_get_dma_sg_table(struct dma_block * block, \
+	struct device * dev, enum dma_data_direction dir);
+
+/**
+ * dma_block_get_sg_nents - Get the number of SG entries needed
+ * to describe a range of the DMA block.
+ *
+ * Physically contiguous memory (huge pages, folios, high-order
+ * allocations...) is described with a single SG entry up to
+ * the maximum segment size or the next segment boundary.
+ *
+ * @block: DMA Block.
+ * @offset: Offset within the DMA block.
+ * @len: Length of the range.
+ * @max_seg: Maximum size of a SG entry (e.g. dma_get_max_seg_size).
+ * @seg_boundary: Segment boundary mask (e.g. dma_get_seg_boundary).
+ *
+ * Return: The number of SG entries or a negative value on error.
+ */
+int dma_block_get_sg_nents(struct dma_block * block, size_t offset, \
+	size_t len, unsigned int max_seg, unsigned long seg_boundary);
+
+/**
+ * dma_block_setup_sg - Fill the SG entries that describe a
+ * range of the DMA block.
+ *
+ * @block: DMA Block.
+ * @offset: Offset within the DMA block.
+ * @len: Length of the range.
+ * @max_seg: Maximum size of a SG entry (e.g. dma_get_max_seg_size).
+ * @seg_boundary: Segment boundary mask (e.g. dma_get_seg_boundary).
+ * @sg: First SG entry to fill. It is updated to the next free entry.
+ * @nents: Number of free SG entries.
+ *
+ * Return: The number of SG entries filled or a negative value on error.
+ */
+int dma_block_setup_sg(struct dma_block * block, size_t offset, \
+	size_t len, unsigned int max_seg, unsigned long seg_boundary, \
+	struct scatterlist ** sg, int nents);
 	
 /**
  * 
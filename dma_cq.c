@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA Completion Queue functions (implementation).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include <linux/slab.h>
+
+#include "dma_cq.h"
+
+struct dma_cq * dma_cq_create(gfp_t gfp)
+{
+	struct dma_cq * cq = NULL;
+
+	cq = kzalloc(sizeof(*cq),gfp);
+	if(cq != NULL) {
+		init_llist_head(&cq->list);
+		init_waitqueue_head(&cq->wait);
+	}
+
+	return cq;
+}
+
+void dma_cq_bind(struct dma_cq * cq, struct dma_op * op, u64 user_data)
+{
+	op->cq = cq;
+	op->user_data = user_data;
+}
+
+void dma_cq_push(struct dma_cq * cq, struct dma_op * op)
+{
+	/* Only the first push after a drain wakes up the consumer */
+	if(llist_add(&op->cq_node,&cq->list))
+		wake_up(&cq->wait);
+}
+
+unsigned int dma_cq_drain(struct dma_cq * cq, struct dma_op ** ops, \
+	unsigned int n)
+{
+	struct llist_node * node;
+	unsigned int i = 0;
+
+	while(i < n) {
+		/* The list is LIFO: take it all and reverse it */
+		if(cq->batch == NULL) {
+			cq->batch = llist_reverse_order(llist_del_all(&cq->list));
+			if(cq->batch == NULL)
+				break;
+		}
+
+		node = cq->batch;
+		cq->batch = node->next;
+		ops[i++] = llist_entry(node,struct dma_op,cq_node);
+	}
+
+	return i;
+}
+
+long dma_cq_wait(struct dma_cq * cq, long timeout)
+{
+	return wait_event_interruptible_timeout(cq->wait, \
+		cq->batch != NULL || !llist_empty(&cq->list),timeout);
+}
+
+void dma_cq_free(struct dma_cq * cq)
+{
+	if(cq != NULL)
+		kfree(cq);
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA Completion Queue functions (header).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef DMA_CQ_H
+#define DMA_CQ_H
+
+#include <linux/types.h>
+#include <linux/llist.h>
+#include <linux/wait.h>
+
+#include "dma_op.h"
+
+/**
+ *
+ * DMA Completion Queue structure. The DMA Operations that are bound
+ * to it are pushed (lock-free) from the DMA callback context when all
+ * their Xfers have completed, and a single consumer drains them in
+ * batches.
+ *
+ */
+struct dma_cq {
+	/* Completed DMA Operations (producers) */
+	struct llist_head list;
+
+	/* DMA Operations taken by the consumer (oldest first) */
+	struct llist_node * batch;
+
+	/* The consumer sleeps here when the queue is empty */
+	wait_queue_head_t wait;
+};
+
+/**
+ *
+ * dma_cq_create - Create a new DMA Completion Queue.
+ *
+ * @gfp: Specific flags to request memory.
+ *
+ * Return: A DMA Completion Queue.
+ *
+ */
+struct dma_cq * dma_cq_create(gfp_t gfp);
+
+/**
+ *
+ * dma_cq_bind - Bind a DMA Operation to the DMA Completion Queue. It
+ * must be called before dma_op_start. The DMA Operation is pushed
+ * once per start, with its status and residue, and it must not be
+ * released until it has been drained.
+ *
+ * @cq: DMA Completion Queue pointer.
+ * @op: DMA Operation pointer.
+ * @user_data: Value for the consumer (op->user_data).
+ *
+ */
+void dma_cq_bind(struct dma_cq * cq, struct dma_op * op, u64 user_data);
+
+/**
+ *
+ * dma_cq_push - Push a completed DMA Operation. It is called from the
+ * DMA callback context and it can be called from any number of
+ * producers at the same time.
+ *
+ * @cq: DMA Completion Queue pointer.
+ * @op: DMA Operation pointer.
+ *
+ */
+void dma_cq_push(struct dma_cq * cq, struct dma_op * op);
+
+/**
+ *
+ * dma_cq_drain - Take the completed DMA Operations in completion
+ * order. Only one consumer may drain the queue at the same time.
+ *
+ * @cq: DMA Completion Queue pointer.
+ * @ops: Array for the completed DMA Operations.
+ * @n: Array size.
+ *
+ * Return: The number of DMA Operations stored in ops.
+ *
+ */
+unsigned int dma_cq_drain(struct dma_cq * cq, struct dma_op ** ops, \
+	unsigned int n);
+
+/**
+ *
+ * dma_cq_wait - Wait until the DMA Completion Queue is not empty.
+ *
+ * @cq: DMA Completion Queue pointer.
+ * @timeout: Timeout (jiffies).
+ *
+ * Return: A positive value if there are completed DMA Operations,
+ * 0 on timeout or a negative value if interrupted.
+ *
+ */
+long dma_cq_wait(struct dma_cq * cq, long timeout);
+
+/**
+ *
+ * dma_cq_free - Destroy a DMA Completion Queue. The bound DMA
+ * Operations must have completed.
+ *
+ * @cq: DMA Completion Queue pointer.
+ *
+ */
+void dma_cq_free(struct dma_cq * cq);
+
+#endif /* DMA_CQ_H */
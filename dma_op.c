@@ -9,16 +9,21 @@
 */
 
 #include <linux/slab.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
 
 #include "dma_op.h"
+#include "dma_cq.h"
 
 struct dma_op * dma_op_create(gfp_t gfp)
 {
 	struct dma_op * op = NULL;
 	
 	op = kzalloc(sizeof(*op),gfp);
-	if(op != NULL)
+	if(op != NULL) {
 		INIT_LIST_HEAD(&op->list_dma_xfer);
+		INIT_LIST_HEAD(&op->list_dep);
+	}
 	
 	return op;
 }
@@ -39,12 +44,24 @@ int dma_op_add_xfer(struct dma_op * op, \
 int dma_op_del_xfer(struct dma_op * op, \
 	struct dma_xfer * xfer)
 {
+	struct dma_op_dep * dep;
+	struct dma_op_dep * aux;
 	int r = 0;
 
-	if(op != NULL && xfer != NULL)
+	if(op != NULL && xfer != NULL) {
 		list_del(&xfer->node);
-	else
+
+		/* Its dependencies go away with it */
+		list_for_each_entry_safe(dep,aux,&op->list_dep,node) {
+			if(dep->pred == xfer || dep->succ == xfer) {
+				dep->succ->dma_npreds--;
+				list_del(&dep->node);
+				kfree(dep);
+			}
+		}
+	} else {
 		r = -1;
+	}
 
 	return r;
 }
@@ -67,23 +84,166 @@ int dma_op_clear_xfer(struct dma_op * op)
 	return r;
 }
 
-int dma_op_start(struct dma_op * op)
+/* The Xfers only report to the DMA Operation if someone is waiting */
+static int _dma_op_tracked(struct dma_op * op)
+{
+	return op->cq != NULL || !list_empty(&op->list_dep);
+}
+
+static void _dma_op_complete(struct dma_op * op)
+{
+	if(op->cq != NULL)
+		dma_cq_push(op->cq,op);
+}
+
+/* An Xfer that will never be started completes as aborted */
+static void _dma_op_xfer_skip(struct dma_op * op, struct dma_xfer * xfer)
+{
+	xfer->dma_result = DMA_TRANS_ABORTED;
+	xfer->dma_residue = xfer->len;
+
+	/* The Xfer is signalled after the accounting */
+	dma_op_xfer_done(op,xfer,DMA_TRANS_ABORTED,xfer->len);
+}
+
+/* Start the successors whose predecessors have all completed */
+static void _dma_op_release_succs(struct dma_op * op, \
+	struct dma_xfer * pred, int failed)
+{
+	struct dma_op_dep * dep;
+	struct dma_xfer * succ;
+
+	list_for_each_entry(dep,&op->list_dep,node) {
+		if(dep->pred != pred)
+			continue;
+
+		succ = dep->succ;
+		if(failed)
+			WRITE_ONCE(succ->dma_pred_failed,1);
+
+		if(!atomic_dec_and_test(&succ->dma_preds_left))
+			continue;
+
+		if(READ_ONCE(succ->dma_pred_failed) || dma_xfer_start(succ) != 0)
+			_dma_op_xfer_skip(op,succ);
+	}
+}
+
+int dma_op_add_dep(struct dma_op * op, struct dma_xfer * pred, \
+	struct dma_xfer * succ, gfp_t gfp)
+{
+	struct dma_op_dep * dep;
+
+	if(op == NULL || pred == NULL || succ == NULL || pred == succ)
+		return -1;
+
+	dep = kmalloc(sizeof(*dep),gfp);
+	if(dep == NULL)
+		return -2;
+
+	dep->pred = pred;
+	dep->succ = succ;
+	list_add_tail(&dep->node,&op->list_dep);
+	succ->dma_npreds++;
+
+	return 0;
+}
+
+static void _dma_op_free_deps(struct dma_op * op, int reset)
+{
+	struct dma_op_dep * dep;
+	struct dma_op_dep * aux;
+
+	list_for_each_entry_safe(dep,aux,&op->list_dep,node) {
+		if(reset)
+			dep->succ->dma_npreds = 0;
+		list_del(&dep->node);
+		kfree(dep);
+	}
+}
+
+void dma_op_clear_deps(struct dma_op * op)
+{
+	_dma_op_free_deps(op,1);
+}
+
+static int _dma_op_start(struct dma_op * op, int issue)
 {
 	struct list_head *p;
 	struct dma_xfer *xfer;
+	int tracked = _dma_op_tracked(op);
+	int n = 0;
 	int r = 0;
 	
 	list_for_each(p,&op->list_dma_xfer) {
 		xfer = list_entry(p,struct dma_xfer,node);
+		xfer->op = tracked ? op : NULL;
+		xfer->dma_pred_failed = 0;
+		atomic_set(&xfer->dma_preds_left,xfer->dma_npreds);
+		n++;
+	}
+	
+	op->status = 0;
+	atomic_long_set(&op->residue,0);
+	atomic_set(&op->pending,n);
+	
+	/* The successors are started from the DMA callbacks */
+	list_for_each(p,&op->list_dma_xfer) {
+		xfer = list_entry(p,struct dma_xfer,node);
+		if(xfer->dma_npreds > 0)
+			continue;
 		
-		r = dma_xfer_start(xfer);
-		if(r != 0)
-			break;
+		if(r == 0)
+			r = issue ? dma_xfer_start(xfer) : dma_xfer_submit(xfer);
+		
+		/* The Xfers that have not been started will never complete */
+		if(r != 0) {
+			if(!tracked)
+				break;
+			_dma_op_xfer_skip(op,xfer);
+		}
 	}
 	
 	return r;
 }
 
+int dma_op_start(struct dma_op * op)
+{
+	return _dma_op_start(op,1);
+}
+
+int dma_op_submit(struct dma_op * op)
+{
+	return _dma_op_start(op,0);
+}
+
+void dma_op_xfer_done(struct dma_op * op, struct dma_xfer * xfer, \
+	enum dmaengine_tx_result result, u32 residue)
+{
+	int failed = (result != DMA_TRANS_NOERROR);
+
+	if(failed) {
+		WRITE_ONCE(op->status,-1);
+		atomic_long_add(residue,&op->residue);
+	}
+	
+	_dma_op_release_succs(op,xfer,failed);
+	
+	/*
+	 * Nothing may be used once the DMA Operation can be released: the
+	 * consumer of the DMA Completion Queue releases it after the last
+	 * push, dma_op_wait after the last Xfer is signalled.
+	 */
+	if(op->cq != NULL) {
+		complete_all(&xfer->done);
+		if(atomic_dec_and_test(&op->pending))
+			_dma_op_complete(op);
+	} else {
+		atomic_dec(&op->pending);
+		complete_all(&xfer->done);
+	}
+}
+
 int dma_op_all_xfers_completed(struct dma_op * op)
 {
 	struct list_head *p;
@@ -102,6 +262,33 @@ int dma_op_all_xfers_completed(struct dma_op * op)
 	return r;
 }
 
+int dma_op_wait(struct dma_op * op, u64 poll_ns, unsigned long timeout)
+{
+	struct list_head *p;
+	struct dma_xfer *xfer;
+	ktime_t start = ktime_get();
+	unsigned long end = jiffies+timeout;
+	s64 elapsed;
+	int r = 0;
+
+	list_for_each(p,&op->list_dma_xfer) {
+		xfer = list_entry(p,struct dma_xfer,node);
+
+		elapsed = ktime_to_ns(ktime_sub(ktime_get(),start));
+		if(time_after(jiffies,end))
+			timeout = 0;
+		else
+			timeout = end-jiffies;
+
+		r = dma_xfer_wait(xfer,((u64) elapsed < poll_ns) ? \
+			poll_ns-elapsed : 0,timeout);
+		if(r != 0)
+			break;
+	}
+
+	return r;
+}
+
 int dma_op_xfer_error(struct dma_op * op)
 {
 	struct list_head *p;
@@ -122,6 +309,9 @@ int dma_op_xfer_error(struct dma_op * op)
 
 void dma_op_free(struct dma_op * op) 
 {
-	if(op != NULL)
+	if(op != NULL) {
+		/* The Xfers may have been released already */
+		_dma_op_free_deps(op,0);
 		kfree(op);
+	}
 }
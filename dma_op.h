@@ -11,8 +11,27 @@
 #ifndef DMA_OP_H
 #define DMA_OP_H
 
+#include <linux/atomic.h>
+#include <linux/llist.h>
+
 #include "dma_xfer.h"
 
+struct dma_cq;
+
+/**
+ *
+ * DMA Operation dependency. The successor Xfer is started from the DMA
+ * callback of the predecessor Xfer.
+ *
+ */
+struct dma_op_dep {
+	struct dma_xfer * pred;
+	struct dma_xfer * succ;
+	
+	/* Dependency linked list */
+	struct list_head node;
+};
+
 /**
  * 
  * DMA Operation structure. It contains several DMA transactions/transfers.
@@ -21,6 +40,21 @@
 struct dma_op {
 	/* Xfer list */
 	struct list_head list_dma_xfer;
+	
+	/* Dependencies between the Xfers */
+	struct list_head list_dep;
+	
+	/* Xfers that have not completed yet (tracked DMA Operations) */
+	atomic_t pending;
+	
+	/* Result: 0 or -1 if any Xfer has failed, and the bytes left */
+	int status;
+	atomic_long_t residue;
+	
+	/* DMA Completion Queue */
+	struct dma_cq * cq;
+	u64 user_data;
+	struct llist_node cq_node;
 };
 
 /**
@@ -72,15 +106,76 @@ int dma_op_del_xfer(struct dma_op * op, \
  */
 int dma_op_clear_xfer(struct dma_op * op);
 	
+/**
+ *
+ * dma_op_add_dep - Add a dependency between two Xfers of the DMA
+ * Operation: succ is started (from the DMA callback context) when
+ * pred and its other predecessors have completed. If any predecessor
+ * fails, succ is not started and it completes as aborted.
+ *
+ * Both Xfers must be prepared before dma_op_start, pred must be
+ * prepared with DMA_PREP_INTERRUPT and the dependencies must not
+ * form a cycle.
+ *
+ * @op: DMA Operation pointer.
+ * @pred: Predecessor Xfer.
+ * @succ: Successor Xfer.
+ * @gfp: Specific flags to request memory.
+ *
+ * Return: 0 if sucess and an error code otherwise.
+ *
+ */
+int dma_op_add_dep(struct dma_op * op, struct dma_xfer * pred, \
+	struct dma_xfer * succ, gfp_t gfp);
+
+/**
+ *
+ * dma_op_clear_deps - Remove all the dependencies of the DMA Operation.
+ *
+ * @op: DMA Operation pointer.
+ *
+ */
+void dma_op_clear_deps(struct dma_op * op);
+
 /**
  * 
  * dma_op_start - Start all the transfers of the DMA Operation.
+ * The transfers with predecessors are started when these complete.
  * 
  * Return: 0 if success and an error code otherwise.
  * 
  */
 int dma_op_start(struct dma_op * op);
 
+/**
+ *
+ * dma_op_submit - Submit the transfers of the DMA Operation without
+ * issuing them: the caller must call dma_async_issue_pending on their
+ * channels. It allows to build a batch of DMA Operations in a given
+ * order. The transfers with predecessors are started when these
+ * complete.
+ *
+ * Return: 0 if success and an error code otherwise.
+ *
+ */
+int dma_op_submit(struct dma_op * op);
+
+/**
+ *
+ * dma_op_xfer_done - Account the completion of an Xfer of a tracked
+ * DMA Operation, start its successors and signal the Xfer (called from
+ * the DMA callback of the Xfer). The DMA Operation and the Xfer must
+ * not be used after this: the waiters may release them.
+ *
+ * @op: DMA Operation pointer.
+ * @xfer: DMA Xfer pointer.
+ * @result: DMA result of the Xfer.
+ * @residue: Bytes left of the Xfer.
+ *
+ */
+void dma_op_xfer_done(struct dma_op * op, struct dma_xfer * xfer, \
+	enum dmaengine_tx_result result, u32 residue);
+
 /**
  * dma_op_all_xfers_completed - Check if all Xfers have been
  * completed.
@@ -90,6 +185,21 @@ int dma_op_start(struct dma_op * op);
  */
 int dma_op_all_xfers_completed(struct dma_op * op);
 
+/**
+ * dma_op_wait - Wait until all the Xfers have completed (@see
+ * dma_xfer_wait). The busy-poll window and the timeout are for the
+ * whole DMA Operation.
+ *
+ * @op: DMA Operation pointer.
+ * @poll_ns: Busy-poll window (ns, 0: sleep at once).
+ * @timeout: Timeout (jiffies).
+ *
+ * Return: 0 if all the Xfers have completed, -1 if any of them has
+ * failed and -2 on timeout.
+ *
+ */
+int dma_op_wait(struct dma_op * op, u64 poll_ns, unsigned long timeout);
+
 /**
  * dma_op_xfer_error - Check if any error occurs in
  * some xfer.
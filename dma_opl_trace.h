@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA Operation Layer tracepoints (header).
+ *
+ * The events are created in dma_xfer.c (CREATE_TRACE_POINTS). This
+ * header is included from the source directory, so the module must be
+ * built with -I$(src) (e.g. ccflags-y += -I$(src)).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM dma_opl
+
+#if !defined(DMA_OPL_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define DMA_OPL_TRACE_H
+
+#include <linux/tracepoint.h>
+
+#include "dma_xfer.h"
+#include "packet_desc.h"
+
+#define show_dma_opl_dir(dir) \
+	__print_symbolic(dir, \
+		{ DMA_MEM_TO_MEM, "MEM_TO_MEM" }, \
+		{ DMA_MEM_TO_DEV, "MEM_TO_DEV" }, \
+		{ DMA_DEV_TO_MEM, "DEV_TO_MEM" }, \
+		{ DMA_DEV_TO_DEV, "DEV_TO_DEV" }, \
+		{ DMA_TRANS_NONE, "NONE" })
+
+/* DMA Xfer events */
+DECLARE_EVENT_CLASS(dma_opl_xfer,
+
+	TP_PROTO(struct dma_xfer * xfer, int ret),
+
+	TP_ARGS(xfer, ret),
+
+	TP_STRUCT__entry(
+		__field(const void *, xfer)
+		__field(dma_cookie_t, cookie)
+		__field(unsigned int, nents)
+		__field(size_t, len)
+		__field(int, dir)
+		__field(int, ret)
+	),
+
+	TP_fast_assign(
+		__entry->xfer = xfer;
+		__entry->cookie = xfer->dma_cookie;
+		__entry->nents = xfer->sgt.nents;
+		__entry->len = xfer->len;
+		__entry->dir = xfer->dma_dir;
+		__entry->ret = ret;
+	),
+
+	TP_printk("xfer=%p cookie=%d nents=%u len=%zu dir=%s ret=%d",
+		__entry->xfer, __entry->cookie, __entry->nents, __entry->len,
+		show_dma_opl_dir(__entry->dir), __entry->ret)
+);
+
+DEFINE_EVENT(dma_opl_xfer, dma_xfer_map_sg,
+	TP_PROTO(struct dma_xfer * xfer, int ret),
+	TP_ARGS(xfer, ret)
+);
+
+DEFINE_EVENT(dma_opl_xfer, dma_xfer_prep_start_sg,
+	TP_PROTO(struct dma_xfer * xfer, int ret),
+	TP_ARGS(xfer, ret)
+);
+
+DEFINE_EVENT(dma_opl_xfer, dma_xfer_prep_start_cyclic,
+	TP_PROTO(struct dma_xfer * xfer, int ret),
+	TP_ARGS(xfer, ret)
+);
+
+DEFINE_EVENT(dma_opl_xfer, dma_xfer_prep_start_memcpy,
+	TP_PROTO(struct dma_xfer * xfer, int ret),
+	TP_ARGS(xfer, ret)
+);
+
+DEFINE_EVENT(dma_opl_xfer, dma_xfer_submit,
+	TP_PROTO(struct dma_xfer * xfer, int ret),
+	TP_ARGS(xfer, ret)
+);
+
+DEFINE_EVENT(dma_opl_xfer, dma_xfer_start,
+	TP_PROTO(struct dma_xfer * xfer, int ret),
+	TP_ARGS(xfer, ret)
+);
+
+DEFINE_EVENT(dma_opl_xfer, dma_xfer_free,
+	TP_PROTO(struct dma_xfer * xfer, int ret),
+	TP_ARGS(xfer, ret)
+);
+
+/* DMA callback of the last descriptor of a DMA Xfer */
+TRACE_EVENT(dma_xfer_complete,
+
+	TP_PROTO(struct dma_xfer * xfer,
+		const struct dmaengine_result * result),
+
+	TP_ARGS(xfer, result),
+
+	TP_STRUCT__entry(
+		__field(const void *, xfer)
+		__field(dma_cookie_t, cookie)
+		__field(unsigned int, nents)
+		__field(size_t, len)
+		__field(int, dir)
+		__field(int, result)
+		__field(u32, residue)
+	),
+
+	TP_fast_assign(
+		__entry->xfer = xfer;
+		__entry->cookie = xfer->dma_cookie;
+		__entry->nents = xfer->sgt.nents;
+		__entry->len = xfer->len;
+		__entry->dir = xfer->dma_dir;
+		__entry->result = result ? result->result : DMA_TRANS_NOERROR;
+		__entry->residue = result ? result->residue : 0;
+	),
+
+	TP_printk("xfer=%p cookie=%d nents=%u len=%zu dir=%s result=%d residue=%u",
+		__entry->xfer, __entry->cookie, __entry->nents, __entry->len,
+		show_dma_opl_dir(__entry->dir), __entry->result,
+		__entry->residue)
+);
+
+/* Packet descriptor events (first DMA Xfer of the descriptor) */
+DECLARE_EVENT_CLASS(dma_opl_pdesc,
+
+	TP_PROTO(struct pdesc * desc, size_t bytes),
+
+	TP_ARGS(desc, bytes),
+
+	TP_STRUCT__entry(
+		__field(const void *, desc)
+		__field(const void *, xfer)
+		__field(u16, id)
+		__field(dma_cookie_t, cookie)
+		__field(unsigned int, nents)
+		__field(size_t, len)
+		__field(int, dir)
+	),
+
+	TP_fast_assign(
+		struct dma_xfer * xfer = list_first_entry(
+			&desc->dma_op->list_dma_xfer, struct dma_xfer, node);
+
+		__entry->desc = desc;
+		__entry->xfer = xfer;
+		__entry->id = desc->id;
+		__entry->cookie = xfer->dma_cookie;
+		__entry->nents = xfer->sgt.nents;
+		__entry->len = bytes;
+		__entry->dir = xfer->dma_dir;
+	),
+
+	TP_printk("desc=%p id=%u xfer=%p cookie=%d nents=%u len=%zu dir=%s",
+		__entry->desc, __entry->id, __entry->xfer, __entry->cookie,
+		__entry->nents, __entry->len, show_dma_opl_dir(__entry->dir))
+);
+
+DEFINE_EVENT(dma_opl_pdesc, pdesc_copy_from,
+	TP_PROTO(struct pdesc * desc, size_t bytes),
+	TP_ARGS(desc, bytes)
+);
+
+DEFINE_EVENT(dma_opl_pdesc, pdesc_copy_to,
+	TP_PROTO(struct pdesc * desc, size_t bytes),
+	TP_ARGS(desc, bytes)
+);
+
+TRACE_EVENT(pdesc_pool_find,
+
+	TP_PROTO(struct pdesc_pool * pool, u16 id, struct pdesc * desc),
+
+	TP_ARGS(pool, id, desc),
+
+	TP_STRUCT__entry(
+		__field(const void *, pool)
+		__field(u16, id)
+		__field(const void *, desc)
+	),
+
+	TP_fast_assign(
+		__entry->pool = pool;
+		__entry->id = id;
+		__entry->desc = desc;
+	),
+
+	TP_printk("pool=%p id=%u desc=%p",
+		__entry->pool, __entry->id, __entry->desc)
+);
+
+#endif /* DMA_OPL_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE dma_opl_trace
+
+#include <trace/define_trace.h>
@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA Ring buffer functions (implementation).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include <linux/slab.h>
+#include <linux/dma-mapping.h>
+#include <linux/math64.h>
+
+#include "dma_ring.h"
+
+/* Offset of a stream position in the buffer (no u64 modulo on 32-bit) */
+static size_t _dma_ring_offset(struct dma_ring * ring, u64 pos)
+{
+	u64 rem;
+
+	div64_u64_rem(pos,ring->len,&rem);
+
+	return rem;
+}
+
+/* Update the producer position and detect overruns (lock held) */
+static void _dma_ring_update(struct dma_ring * ring)
+{
+	struct dma_xfer * xfer = ring->xfer;
+	struct dma_tx_state state;
+	u64 done = ring->periods*ring->period_len;
+	u64 pos;
+
+	if(ring->produced < done)
+		ring->produced = done;
+
+	/* Position of the hardware inside the current period */
+	if(ring->residue_ok && \
+		dmaengine_tx_status(xfer->dma_chan,xfer->dma_cookie,&state) \
+			!= DMA_ERROR && \
+		state.residue <= ring->len) {
+		pos = done-_dma_ring_offset(ring,done) + \
+			(ring->len-state.residue) % ring->len;
+		if(pos < done)
+			pos += ring->len;
+
+		if(pos > ring->produced)
+			ring->produced = pos;
+	}
+
+	/* Keep the data that is not being overwritten */
+	if(ring->produced-ring->consumed > ring->len) {
+		ring->overruns++;
+		ring->consumed = ring->produced-(ring->len-ring->period_len);
+	}
+}
+
+static void _dma_ring_callback(void * param)
+{
+	struct dma_ring * ring = param;
+	void (*period_f)(struct dma_ring * ring, void * param);
+	void * period_param;
+	unsigned long flags;
+	u64 avail;
+
+	spin_lock_irqsave(&ring->lock,flags);
+	ring->periods++;
+	_dma_ring_update(ring);
+	avail = ring->produced-ring->consumed;
+	period_f = ring->period_f;
+	period_param = ring->period_param;
+	if(period_f != NULL)
+		ring->period_busy++;
+	spin_unlock_irqrestore(&ring->lock,flags);
+
+	if(avail >= ring->low_water)
+		wake_up_interruptible(&ring->wait);
+
+	if(period_f != NULL) {
+		period_f(ring,period_param);
+
+		spin_lock_irqsave(&ring->lock,flags);
+		ring->period_busy--;
+		spin_unlock_irqrestore(&ring->lock,flags);
+
+		/* dma_ring_set_period_cb waits on the queue of the readers */
+		wake_up_all(&ring->wait);
+	}
+}
+
+static int _dma_ring_period_idle(struct dma_ring * ring)
+{
+	unsigned long flags;
+	int idle;
+
+	spin_lock_irqsave(&ring->lock,flags);
+	idle = (ring->period_busy == 0);
+	spin_unlock_irqrestore(&ring->lock,flags);
+
+	return idle;
+}
+
+struct dma_ring * dma_ring_create(struct dma_chan * dma_chan, \
+	struct dma_slave_config * dma_config, struct device * hwdev, \
+	size_t len, size_t period_len, gfp_t gfp)
+{
+	struct dma_ring * ring;
+	struct dma_cyclic_info dcyc_info;
+	struct dma_slave_caps caps;
+
+	if(period_len == 0 || len == 0 || (len % period_len) != 0)
+		return NULL;
+
+	ring = kzalloc(sizeof(*ring),gfp);
+	if(ring == NULL)
+		return NULL;
+
+	ring->vaddr = dma_alloc_coherent(hwdev,len,&ring->dma_addr,gfp);
+	if(ring->vaddr == NULL)
+		goto err_buf;
+
+	ring->xfer = dma_xfer_create(dma_chan,dma_config,hwdev,gfp);
+	if(ring->xfer == NULL)
+		goto err_xfer;
+
+	ring->hwdev = hwdev;
+	ring->len = len;
+	ring->period_len = period_len;
+	ring->low_water = period_len;
+
+	if(dma_get_slave_caps(dma_chan,&caps) == 0)
+		ring->residue_ok = (caps.residue_granularity != \
+			DMA_RESIDUE_GRANULARITY_DESCRIPTOR);
+
+	dcyc_info.dma_addr = ring->dma_addr;
+	dcyc_info.len = len;
+	dcyc_info.period_len = period_len;
+	dma_xfer_cyclic_setup(ring->xfer,&dcyc_info);
+
+	init_waitqueue_head(&ring->wait);
+	spin_lock_init(&ring->lock);
+
+	return ring;
+
+err_xfer:
+	dma_free_coherent(hwdev,len,ring->vaddr,ring->dma_addr);
+err_buf:
+	kfree(ring);
+
+	return NULL;
+}
+
+void dma_ring_set_period_cb(struct dma_ring * ring, \
+	void (*period_f)(struct dma_ring * ring, void * param), \
+	void * param)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ring->lock,flags);
+	ring->period_f = period_f;
+	ring->period_param = param;
+	spin_unlock_irqrestore(&ring->lock,flags);
+
+	/* The previous function may still be running */
+	wait_event(ring->wait,_dma_ring_period_idle(ring));
+}
+
+void dma_ring_set_low_water(struct dma_ring * ring, size_t low_water)
+{
+	ring->low_water = max_t(size_t,low_water,1);
+}
+
+int dma_ring_start(struct dma_ring * ring)
+{
+	unsigned long flags;
+	int r;
+
+	spin_lock_irqsave(&ring->lock,flags);
+	ring->produced = 0;
+	ring->consumed = 0;
+	ring->periods = 0;
+	spin_unlock_irqrestore(&ring->lock,flags);
+
+	r = dma_xfer_prep_start_cyclic(ring->xfer,DMA_DEV_TO_MEM, \
+		_dma_ring_callback,ring,DMA_PREP_INTERRUPT);
+	if(r != 0)
+		return r;
+
+	return dma_xfer_start(ring->xfer);
+}
+
+void dma_ring_stop(struct dma_ring * ring)
+{
+	dmaengine_terminate_sync(ring->xfer->dma_chan);
+
+	/* Wake up the readers */
+	wake_up_interruptible(&ring->wait);
+}
+
+size_t dma_ring_avail(struct dma_ring * ring)
+{
+	unsigned long flags;
+	size_t avail;
+
+	spin_lock_irqsave(&ring->lock,flags);
+	_dma_ring_update(ring);
+	avail = ring->produced-ring->consumed;
+	spin_unlock_irqrestore(&ring->lock,flags);
+
+	return avail;
+}
+
+size_t dma_ring_peek(struct dma_ring * ring, struct dma_ring_span * span)
+{
+	unsigned long flags;
+	size_t avail;
+	size_t start;
+
+	spin_lock_irqsave(&ring->lock,flags);
+	_dma_ring_update(ring);
+	avail = ring->produced-ring->consumed;
+	start = _dma_ring_offset(ring,ring->consumed);
+	spin_unlock_irqrestore(&ring->lock,flags);
+
+	span->buf = ring->vaddr+start;
+	span->len = min(avail,ring->len-start);
+
+	return avail;
+}
+
+void dma_ring_consume(struct dma_ring * ring, size_t len)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ring->lock,flags);
+	ring->consumed = min(ring->consumed+len,ring->produced);
+	spin_unlock_irqrestore(&ring->lock,flags);
+}
+
+void dma_ring_consume_to(struct dma_ring * ring, u64 pos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ring->lock,flags);
+	if(pos > ring->consumed)
+		ring->consumed = min(pos,ring->produced);
+	spin_unlock_irqrestore(&ring->lock,flags);
+}
+
+void dma_ring_get_pos(struct dma_ring * ring, u64 * produced, \
+	u64 * periods, u64 * overruns)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ring->lock,flags);
+	_dma_ring_update(ring);
+	*produced = ring->produced;
+	*periods = ring->periods;
+	*overruns = ring->overruns;
+	spin_unlock_irqrestore(&ring->lock,flags);
+}
+
+long dma_ring_wait(struct dma_ring * ring, size_t len, long timeout)
+{
+	long r;
+
+	if(len == 0)
+		len = ring->low_water;
+
+	r = wait_event_interruptible_timeout(ring->wait, \
+		dma_ring_avail(ring) >= len,timeout);
+	if(r <= 0)
+		return r;
+
+	return dma_ring_avail(ring);
+}
+
+void dma_ring_free(struct dma_ring * ring)
+{
+	if(ring != NULL) {
+		dma_ring_stop(ring);
+		dma_xfer_free(ring->xfer);
+		dma_free_coherent(ring->hwdev,ring->len,ring->vaddr, \
+			ring->dma_addr);
+		kfree(ring);
+	}
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA Ring buffer functions (header).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef DMA_RING_H
+#define DMA_RING_H
+
+#include <linux/types.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/dmaengine.h>
+#include <linux/device.h>
+
+#include "dma_xfer.h"
+
+/**
+ *
+ * DMA Ring span. It is a readable part of the ring buffer that is
+ * contiguous in memory.
+ *
+ */
+struct dma_ring_span {
+	/* Data pointer (inside the ring buffer) */
+	void * buf;
+
+	/* Number of bytes */
+	size_t len;
+};
+
+/**
+ *
+ * DMA Ring structure. It is a consumer of a cyclic DMA transfer
+ * (DEV_TO_MEM) into a coherent ring buffer.
+ *
+ * The positions are monotonic byte counters: the ring tracks how many
+ * bytes the hardware has written (from the completed periods and the
+ * residue of the current one) and how many bytes the consumer has read.
+ * If the hardware overtakes the consumer, an overrun is counted and the
+ * consumer is moved to the oldest data that is still valid.
+ *
+ */
+struct dma_ring {
+	/* Cyclic DMA Xfer */
+	struct dma_xfer * xfer;
+
+	/* Reference to internal Linux dev */
+	struct device * hwdev;
+
+	/* Ring buffer (coherent memory) */
+	void * vaddr;
+	dma_addr_t dma_addr;
+	size_t len;
+	size_t period_len;
+
+	/* The residue is finer than a period */
+	int residue_ok;
+
+	/* Producer and consumer positions (bytes) */
+	u64 produced;
+	u64 consumed;
+
+	/* Counters */
+	u64 periods;
+	u64 overruns;
+
+	/* Readers are woken up when this amount of data is available */
+	size_t low_water;
+	wait_queue_head_t wait;
+
+	/* Optional period callback (and number of calls in progress) */
+	void (*period_f)(struct dma_ring * ring, void * param);
+	void * period_param;
+	unsigned int period_busy;
+
+	spinlock_t lock;
+};
+
+/**
+ *
+ * dma_ring_create - Create a new DMA Ring. The ring buffer is allocated
+ * as coherent memory and the cyclic DMA Xfer is prepared.
+ *
+ * @dma_chan: DMA channel.
+ * @dma_config: DMA configuration settings.
+ * @hwdev: reference to internal Linux device.
+ * @len: Ring buffer size (it must be a multiple of period_len).
+ * @period_len: Period size.
+ * @gfp: Specific flags to request memory.
+ *
+ * Return: A DMA Ring or NULL on error.
+ *
+ */
+struct dma_ring * dma_ring_create(struct dma_chan * dma_chan, \
+	struct dma_slave_config * dma_config, struct device * hwdev, \
+	size_t len, size_t period_len, gfp_t gfp);
+
+/**
+ *
+ * dma_ring_set_period_cb - Set a function that is called (from the
+ * DMA callback context) after each period. It waits for the calls of
+ * the previous function in progress, so its parameter can be released
+ * after this. It may sleep.
+ *
+ * @ring: DMA Ring pointer.
+ * @period_f: Period function.
+ * @param: Period function parameter.
+ *
+ */
+void dma_ring_set_period_cb(struct dma_ring * ring, \
+	void (*period_f)(struct dma_ring * ring, void * param), \
+	void * param);
+
+/**
+ *
+ * dma_ring_set_low_water - Set the amount of data that wakes up the
+ * readers that wait for data (one period by default).
+ *
+ * @ring: DMA Ring pointer.
+ * @low_water: Low-water mark (bytes).
+ *
+ */
+void dma_ring_set_low_water(struct dma_ring * ring, size_t low_water);
+
+/**
+ *
+ * dma_ring_start - Start the cyclic DMA transfer.
+ *
+ * @ring: DMA Ring pointer.
+ *
+ * Return: 0 if success and an error code otherwise.
+ *
+ */
+int dma_ring_start(struct dma_ring * ring);
+
+/**
+ *
+ * dma_ring_stop - Stop the cyclic DMA transfer.
+ *
+ * @ring: DMA Ring pointer.
+ *
+ */
+void dma_ring_stop(struct dma_ring * ring);
+
+/**
+ *
+ * dma_ring_avail - Get the number of bytes ready to be read. An
+ * overrun is detected (and counted) here.
+ *
+ * @ring: DMA Ring pointer.
+ *
+ * Return: The number of bytes ready to be read.
+ *
+ */
+size_t dma_ring_avail(struct dma_ring * ring);
+
+/**
+ *
+ * dma_ring_peek - Get the next readable span of the ring buffer
+ * (zero-copy). If the readable data wraps around the end of the ring
+ * buffer, only the first part is returned: the rest is returned by the
+ * next call after dma_ring_consume.
+ *
+ * @ring: DMA Ring pointer.
+ * @span: Readable span.
+ *
+ * Return: The total number of bytes ready to be read.
+ *
+ */
+size_t dma_ring_peek(struct dma_ring * ring, struct dma_ring_span * span);
+
+/**
+ *
+ * dma_ring_consume - Release bytes that have been read.
+ *
+ * @ring: DMA Ring pointer.
+ * @len: Number of bytes.
+ *
+ */
+void dma_ring_consume(struct dma_ring * ring, size_t len);
+
+/**
+ *
+ * dma_ring_consume_to - Release the data up to an absolute position
+ * (e.g. the tail published by a user space consumer).
+ *
+ * @ring: DMA Ring pointer.
+ * @pos: Consumer position (bytes).
+ *
+ */
+void dma_ring_consume_to(struct dma_ring * ring, u64 pos);
+
+/**
+ *
+ * dma_ring_get_pos - Get the producer position and the counters
+ * of the DMA Ring.
+ *
+ * @ring: DMA Ring pointer.
+ * @produced: Producer position (bytes).
+ * @periods: Number of completed periods.
+ * @overruns: Number of overruns.
+ *
+ */
+void dma_ring_get_pos(struct dma_ring * ring, u64 * produced, \
+	u64 * periods, u64 * overruns);
+
+/**
+ *
+ * dma_ring_wait - Wait until there is some data to be read.
+ *
+ * @ring: DMA Ring pointer.
+ * @len: Number of bytes to wait for (0: the low-water mark).
+ * @timeout: Timeout (jiffies).
+ *
+ * Return: The number of bytes ready to be read, 0 on timeout or
+ * a negative value if interrupted.
+ *
+ */
+long dma_ring_wait(struct dma_ring * ring, size_t len, long timeout);
+
+/**
+ *
+ * dma_ring_free - Destroy a DMA Ring. The cyclic DMA transfer is
+ * stopped and the ring buffer is released.
+ *
+ * @ring: DMA Ring pointer.
+ *
+ */
+void dma_ring_free(struct dma_ring * ring);
+
+#endif /* DMA_RING_H */
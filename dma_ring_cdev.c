@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA Ring character device functions (implementation).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include <linux/slab.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/gfp.h>
+#include <linux/dma-mapping.h>
+
+#include "dma_ring_cdev.h"
+
+/* Publish the producer position in the control page */
+static void _dma_ring_cdev_update(struct dma_ring_cdev * rcdev)
+{
+	u64 produced;
+	u64 periods;
+	u64 overruns;
+
+	dma_ring_get_pos(rcdev->ring,&produced,&periods,&overruns);
+
+	WRITE_ONCE(rcdev->ctrl->periods,periods);
+	WRITE_ONCE(rcdev->ctrl->overruns,overruns);
+
+	/* The consumer reads head before the data */
+	smp_store_release(&rcdev->ctrl->head,produced);
+}
+
+static void _dma_ring_cdev_period(struct dma_ring * ring, void * param)
+{
+	struct dma_ring_cdev * rcdev = param;
+
+	_dma_ring_cdev_update(rcdev);
+	wake_up_interruptible(&rcdev->wait);
+}
+
+static struct dma_ring_cdev * _dma_ring_cdev_from_file(struct file * file)
+{
+	return container_of(file->private_data,struct dma_ring_cdev,misc);
+}
+
+static void _dma_ring_cdev_release_kref(struct kref * kref)
+{
+	struct dma_ring_cdev * rcdev = \
+		container_of(kref,struct dma_ring_cdev,kref);
+
+	free_page((unsigned long) rcdev->ctrl);
+	kfree(rcdev);
+}
+
+static void _dma_ring_cdev_put(struct dma_ring_cdev * rcdev)
+{
+	kref_put(&rcdev->kref,_dma_ring_cdev_release_kref);
+}
+
+static void _dma_ring_cdev_vm_open(struct vm_area_struct * vma)
+{
+	struct dma_ring_cdev * rcdev = vma->vm_private_data;
+
+	kref_get(&rcdev->kref);
+}
+
+static void _dma_ring_cdev_vm_close(struct vm_area_struct * vma)
+{
+	_dma_ring_cdev_put(vma->vm_private_data);
+}
+
+static const struct vm_operations_struct dma_ring_cdev_vm_ops = {
+	.open = _dma_ring_cdev_vm_open,
+	.close = _dma_ring_cdev_vm_close,
+};
+
+/* The mappings of the ring buffer are revoked on unregister */
+static void _dma_ring_cdev_data_vm_open(struct vm_area_struct * vma)
+{
+	struct dma_ring_cdev * rcdev = vma->vm_private_data;
+
+	mutex_lock(&rcdev->lock);
+	rcdev->data_maps++;
+	mutex_unlock(&rcdev->lock);
+
+	kref_get(&rcdev->kref);
+}
+
+static void _dma_ring_cdev_data_vm_close(struct vm_area_struct * vma)
+{
+	struct dma_ring_cdev * rcdev = vma->vm_private_data;
+
+	mutex_lock(&rcdev->lock);
+	rcdev->data_maps--;
+	mutex_unlock(&rcdev->lock);
+
+	_dma_ring_cdev_put(rcdev);
+}
+
+static const struct vm_operations_struct dma_ring_cdev_data_vm_ops = {
+	.open = _dma_ring_cdev_data_vm_open,
+	.close = _dma_ring_cdev_data_vm_close,
+};
+
+static int _dma_ring_cdev_open(struct inode * inode, struct file * file)
+{
+	struct dma_ring_cdev * rcdev = _dma_ring_cdev_from_file(file);
+
+	if(atomic_cmpxchg(&rcdev->open,0,1) != 0)
+		return -EBUSY;
+
+	/* misc_deregister waits for the open calls in progress */
+	kref_get(&rcdev->kref);
+
+	return 0;
+}
+
+static int _dma_ring_cdev_release(struct inode * inode, struct file * file)
+{
+	struct dma_ring_cdev * rcdev = _dma_ring_cdev_from_file(file);
+
+	atomic_set(&rcdev->open,0);
+	_dma_ring_cdev_put(rcdev);
+
+	return 0;
+}
+
+static int _dma_ring_cdev_mmap_locked(struct dma_ring_cdev * rcdev, \
+	struct file * file, struct vm_area_struct * vma)
+{
+	struct dma_ring * ring = rcdev->ring;
+	unsigned long size = vma->vm_end-vma->vm_start;
+	int r;
+
+	if(ring == NULL)
+		return -ENODEV;
+
+	vm_flags_set(vma,VM_DONTEXPAND | VM_DONTDUMP);
+
+	switch(vma->vm_pgoff) {
+	case DMA_RING_CTRL_PGOFF:
+		if(size != PAGE_SIZE)
+			return -EINVAL;
+
+		vma->vm_ops = &dma_ring_cdev_vm_ops;
+
+		return remap_pfn_range(vma,vma->vm_start, \
+			virt_to_phys(rcdev->ctrl) >> PAGE_SHIFT, \
+			PAGE_SIZE,vma->vm_page_prot);
+
+	case DMA_RING_DATA_PGOFF:
+		/* The data is only written by the hardware */
+		if(vma->vm_flags & VM_WRITE)
+			return -EPERM;
+		vm_flags_clear(vma,VM_MAYWRITE);
+
+		if(size > PAGE_ALIGN(ring->len))
+			return -EINVAL;
+
+		vma->vm_pgoff = 0;
+
+		r = dma_mmap_coherent(ring->hwdev,vma,ring->vaddr, \
+			ring->dma_addr,ring->len);
+		if(r != 0)
+			return r;
+
+		/* The mappings are alive: so is the file and its mapping */
+		vma->vm_ops = &dma_ring_cdev_data_vm_ops;
+		rcdev->mapping = file->f_mapping;
+		rcdev->data_maps++;
+
+		return 0;
+
+	default:
+		return -EINVAL;
+	}
+}
+
+static int _dma_ring_cdev_mmap(struct file * file, \
+	struct vm_area_struct * vma)
+{
+	struct dma_ring_cdev * rcdev = _dma_ring_cdev_from_file(file);
+	int r;
+
+	mutex_lock(&rcdev->lock);
+	r = _dma_ring_cdev_mmap_locked(rcdev,file,vma);
+	mutex_unlock(&rcdev->lock);
+
+	if(r != 0)
+		return r;
+
+	/* The control page is kept until the last mapping is gone */
+	vma->vm_private_data = rcdev;
+	kref_get(&rcdev->kref);
+
+	return 0;
+}
+
+static __poll_t _dma_ring_cdev_poll(struct file * file, \
+	struct poll_table_struct * wait)
+{
+	struct dma_ring_cdev * rcdev = _dma_ring_cdev_from_file(file);
+	struct dma_ring * ring;
+	__poll_t mask = 0;
+
+	/* Not the queue of the DMA Ring: it may go away before the file */
+	poll_wait(file,&rcdev->wait,wait);
+
+	mutex_lock(&rcdev->lock);
+
+	ring = rcdev->ring;
+	if(ring == NULL) {
+		mutex_unlock(&rcdev->lock);
+		return EPOLLERR | EPOLLHUP;
+	}
+
+	/* Release the data read by the consumer */
+	dma_ring_consume_to(ring,READ_ONCE(rcdev->ctrl->tail));
+	_dma_ring_cdev_update(rcdev);
+
+	if(dma_ring_avail(ring) >= ring->low_water)
+		mask = EPOLLIN | EPOLLRDNORM;
+
+	mutex_unlock(&rcdev->lock);
+
+	return mask;
+}
+
+static const struct file_operations dma_ring_cdev_fops = {
+	.owner = THIS_MODULE,
+	.open = _dma_ring_cdev_open,
+	.release = _dma_ring_cdev_release,
+	.mmap = _dma_ring_cdev_mmap,
+	.poll = _dma_ring_cdev_poll,
+	.llseek = noop_llseek,
+};
+
+struct dma_ring_cdev * dma_ring_cdev_register(struct dma_ring * ring, \
+	const char * name, gfp_t gfp)
+{
+	struct dma_ring_cdev * rcdev;
+
+	rcdev = kzalloc(sizeof(*rcdev),gfp);
+	if(rcdev == NULL)
+		return NULL;
+
+	rcdev->ctrl = (struct dma_ring_ctrl *) get_zeroed_page(gfp);
+	if(rcdev->ctrl == NULL)
+		goto err_ctrl;
+
+	rcdev->ring = ring;
+	mutex_init(&rcdev->lock);
+	kref_init(&rcdev->kref);
+	init_waitqueue_head(&rcdev->wait);
+	rcdev->ctrl->len = ring->len;
+	rcdev->ctrl->period_len = ring->period_len;
+	atomic_set(&rcdev->open,0);
+
+	strscpy(rcdev->name,name,sizeof(rcdev->name));
+	rcdev->misc.minor = MISC_DYNAMIC_MINOR;
+	rcdev->misc.name = rcdev->name;
+	rcdev->misc.fops = &dma_ring_cdev_fops;
+	rcdev->misc.parent = ring->hwdev;
+
+	dma_ring_set_period_cb(ring,_dma_ring_cdev_period,rcdev);
+
+	if(misc_register(&rcdev->misc) != 0) {
+		dev_err(ring->hwdev,"Cannot register the DMA Ring device \n");
+		goto err_misc;
+	}
+
+	return rcdev;
+
+err_misc:
+	dma_ring_set_period_cb(ring,NULL,NULL);
+	free_page((unsigned long) rcdev->ctrl);
+err_ctrl:
+	kfree(rcdev);
+
+	return NULL;
+}
+
+void dma_ring_cdev_unregister(struct dma_ring_cdev * rcdev)
+{
+	if(rcdev != NULL) {
+		misc_deregister(&rcdev->misc);
+		dma_ring_set_period_cb(rcdev->ring,NULL,NULL);
+
+		/*
+		 * The DMA Ring may be released after this: the user mappings
+		 * of the device are zapped (next accesses get SIGBUS).
+		 */
+		mutex_lock(&rcdev->lock);
+		rcdev->ring = NULL;
+		if(rcdev->data_maps > 0)
+			unmap_mapping_range(rcdev->mapping,0,0,1);
+		mutex_unlock(&rcdev->lock);
+
+		wake_up_interruptible_all(&rcdev->wait);
+
+		_dma_ring_cdev_put(rcdev);
+	}
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA Ring character device functions (header).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef DMA_RING_CDEV_H
+#define DMA_RING_CDEV_H
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/kref.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/miscdevice.h>
+
+#include "dma_ring.h"
+#include "dma_ring_uapi.h"
+
+#define DMA_RING_CDEV_NAME_LEN 32
+
+/**
+ *
+ * DMA Ring character device structure. It exposes a DMA Ring to a
+ * single user space consumer (zero-copy):
+ *
+ *  - mmap at page DMA_RING_CTRL_PGOFF: control page (struct dma_ring_ctrl).
+ *  - mmap at page DMA_RING_DATA_PGOFF: ring buffer (read-only).
+ *  - poll: readable when the low-water mark of the DMA Ring is reached.
+ *
+ * The consumer publishes its position in the tail field of the control
+ * page. It is taken into account on each poll call, so the consumer
+ * does not need any other syscall to release the data.
+ *
+ */
+struct dma_ring_cdev {
+	/* Misc device */
+	struct miscdevice misc;
+	char name[DMA_RING_CDEV_NAME_LEN];
+
+	/* DMA Ring (NULL once the device is unregistered) */
+	struct dma_ring * ring;
+	struct mutex lock;
+
+	/* Mappings of the ring buffer and address space of their file */
+	unsigned int data_maps;
+	struct address_space * mapping;
+
+	/* Poll wait queue (woken on each period and on unregister) */
+	wait_queue_head_t wait;
+
+	/* References: the device, the open file and the mappings */
+	struct kref kref;
+
+	/* Control page (shared with user space) */
+	struct dma_ring_ctrl * ctrl;
+
+	/* Only one consumer at the same time */
+	atomic_t open;
+};
+
+/**
+ *
+ * dma_ring_cdev_register - Register a character device for a DMA Ring.
+ * The period callback of the DMA Ring is used to update the control
+ * page.
+ *
+ * @ring: DMA Ring pointer.
+ * @name: Device name (/dev/<name>).
+ * @gfp: Specific flags to request memory.
+ *
+ * Return: A DMA Ring character device or NULL on error.
+ *
+ */
+struct dma_ring_cdev * dma_ring_cdev_register(struct dma_ring * ring, \
+	const char * name, gfp_t gfp);
+
+/**
+ *
+ * dma_ring_cdev_unregister - Unregister a DMA Ring character device.
+ * The DMA Ring is not released, but it can be after this: the file
+ * stops using it at once and the user mappings are revoked. The
+ * structure and the control page are released when the file is closed
+ * and unmapped.
+ *
+ * @rcdev: DMA Ring character device pointer.
+ *
+ */
+void dma_ring_cdev_unregister(struct dma_ring_cdev * rcdev);
+
+#endif /* DMA_RING_CDEV_H */
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA Ring character device interface (shared with user space).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef DMA_RING_UAPI_H
+#define DMA_RING_UAPI_H
+
+#include <linux/types.h>
+
+/*
+ * mmap offsets of the DMA Ring character device, in pages: the offset
+ * is DMA_RING_*_PGOFF * sysconf(_SC_PAGESIZE). The control page is
+ * mapped read-write and the ring buffer is mapped read-only.
+ */
+#define DMA_RING_CTRL_PGOFF 0
+#define DMA_RING_DATA_PGOFF 1
+
+/**
+ *
+ * DMA Ring control page. The kernel publishes the producer position
+ * (head) after each period; the consumer publishes how much data it
+ * has read (tail). Both are monotonic byte counters: the data of
+ * position pos is at pos % len in the ring buffer.
+ *
+ * The consumer must read head with acquire semantics before reading
+ * the data. If head - tail > len - period_len, the consumer has been
+ * overtaken (overrun) and the data between tail and head - len +
+ * period_len has been lost.
+ *
+ */
+struct dma_ring_ctrl {
+	/* Written by the kernel */
+	__u64 head;
+	__u64 periods;
+	__u64 overruns;
+
+	/* Written by the consumer */
+	__u64 tail;
+
+	/* Ring buffer layout (read-only) */
+	__u32 len;
+	__u32 period_len;
+};
+
+#endif /* DMA_RING_UAPI_H */
@@ -9,13 +9,15 @@
 */
 
 #include <linux/slab.h>
+#include <linux/limits.h>
+#include <linux/kernel.h>
 #include <linux/mm.h>
 #include <asm/page.h>
 
 #include "dma_sg.h"
 
-struct dma_sg * dma_sg_offset_create(struct dma_block * block, \
-	size_t offset, gfp_t gfp)
+struct dma_sg * dma_sg_range_create(struct dma_block * block, \
+	size_t offset, size_t len, gfp_t gfp)
 {
 	struct dma_sg * sg = NULL;
 	
@@ -23,49 +25,128 @@ struct dma_sg * dma_sg_offset_create(struct dma_block * block, \
 	if(sg != NULL) {
 		sg->block = block;
 		sg->offset = offset;
+		sg->len = len;
 	}
 	
 	return sg;
 }
 
+struct dma_sg * dma_sg_offset_create(struct dma_block * block, \
+	size_t offset, gfp_t gfp)
+{
+	return dma_sg_range_create(block,offset,0,gfp);
+}
+
 struct dma_sg * dma_sg_create(struct dma_block * block, \
 	gfp_t gfp)
 {
 	return dma_sg_offset_create(block,0,gfp);
 }
 
-/* This function is inspired by zio_calculate_nents (dma.c) of
- * the ZIO project (http://www.ohwr.org/projects/zio).
- */
 int dma_sg_get_pages(struct dma_sg * sg)
 {
-	void * bufp;
-	int bytesleft;
-	int mapbytes;
-	int nents = 0;
-	struct dma_block * blk;
-	
+	return dma_sg_get_nents(sg,UINT_MAX & PAGE_MASK,ULONG_MAX);
+}
+
+int dma_sg_get_nents(struct dma_sg * sg, unsigned int max_seg, \
+	unsigned long seg_boundary)
+{
 	if(sg == NULL)
 		return -1;
 		
-	blk = sg->block;
+	return dma_block_get_sg_nents(sg->block,sg->offset,\
+		dma_sg_get_len(sg),max_seg,seg_boundary);
+}
+
+size_t dma_sg_get_len(struct dma_sg * sg)
+{
+	size_t size = dma_block_get_size(sg->block);
+	
+	if(sg->len != 0)
+		return sg->len;
+	
+	return (sg->offset < size) ? size-sg->offset : 0;
+}
+
+int dma_sg_split_size(struct dma_block * block, size_t size, \
+	struct dma_sg ** sgs, unsigned int n, gfp_t gfp)
+{
+	size_t bsize = dma_block_get_size(block);
+	size_t offset = 0;
+	unsigned int i = 0;
+	
+	if(size == 0 || DIV_ROUND_UP(bsize,size) > n)
+		return -1;
+	
+	while(offset < bsize) {
+		sgs[i] = dma_sg_range_create(block,offset, \
+			min(size,bsize-offset),gfp);
+		if(sgs[i] == NULL) {
+			while(i--)
+				dma_sg_free(sgs[i]);
+			return -1;
+		}
+		
+		offset += size;
+		i++;
+	}
+	
+	return i;
+}
+
+/* Offset of the block data within its first page (0 if unknown) */
+static size_t _dma_sg_page_offset(struct dma_block * block)
+{
+	unsigned int npages;
+	unsigned int offset;
+	void * buf;
+	
+	if(dma_block_get_pages(block,&npages,&offset) != NULL)
+		return offset;
+	
+	buf = dma_block_get_buffer(block);
+	if(buf != NULL)
+		return offset_in_page(buf);
+	
+	return 0;
+}
+
+int dma_sg_split(struct dma_block * block, struct dma_sg ** sgs, \
+	unsigned int n, gfp_t gfp)
+{
+	size_t bsize = dma_block_get_size(block);
+	size_t head = _dma_sg_page_offset(block);
+	size_t offset = 0;
+	size_t size;
+	size_t len;
+	unsigned int i = 0;
+	
+	if(n == 0)
+		return -1;
 	
-	bufp = dma_block_get_buffer(blk)+sg->offset;
-	bytesleft = dma_block_get_size(blk)-sg->offset;
+	/*
+	 * The split points are page boundaries of the memory, not of the
+	 * block: the first DMA SG is shortened by the offset of the data
+	 * within its first page.
+	 */
+	size = round_up(DIV_ROUND_UP(bsize+head,n),PAGE_SIZE);
+	len = size-head;
 	
-	while(bytesleft) {
-		nents++;
+	while(offset < bsize) {
+		sgs[i] = dma_sg_range_create(block,offset, \
+			min(len,bsize-offset),gfp);
+		if(sgs[i] == NULL) {
+			while(i--)
+				dma_sg_free(sgs[i]);
+			return -1;
+		}
 		
-		if(bytesleft < (PAGE_SIZE - offset_in_page(bufp)))
-			mapbytes = bytesleft;
-		else
-			mapbytes = PAGE_SIZE - offset_in_page(bufp);
-			
-		bufp += mapbytes;
-		bytesleft -= mapbytes;
+		offset += len;
+		len = size;
+		i++;
 	}
 	
-	return nents;
+	return i;
 }
 
 void dma_sg_free(struct dma_sg * sg)
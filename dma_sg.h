@@ -36,6 +36,14 @@ struct dma_sg {
 	 */
 	size_t offset;
 	
+	/* 
+	 * Length of the range of the DMA block
+	 * 
+	 * Zero means up to the end of the DMA block.
+	 * 
+	 */
+	size_t len;
+	
 	/* For the linked list */
 	struct list_head node;
 };
@@ -54,6 +62,21 @@ struct dma_sg {
 struct dma_sg * dma_sg_offset_create(struct dma_block * block, \
 	size_t offset, gfp_t gfp);
 
+/**
+ * 
+ * dma_sg_range_create - Create a DMA SG for a range of a DMA block.
+ * 
+ * @block: DMA block pointer.
+ * @offset: offset for the DMA block.
+ * @len: length of the range (zero means up to the end of the block).
+ * @gfp: Specific flags to request memory.
+ * 
+ * Return: A DMA SG.
+ * 
+ */
+struct dma_sg * dma_sg_range_create(struct dma_block * block, \
+	size_t offset, size_t len, gfp_t gfp);
+
 /**
  * 
  * dma_sg_create - Create a DMA SG with zero offset for a DMA block.
@@ -69,7 +92,9 @@ struct dma_sg * dma_sg_create(struct dma_block * block, \
 
 /**
  * 
- * dma_sg_get_pages - Get the number of pages needed for the DMA SG.
+ * dma_sg_get_pages - Get the number of pages (SG entries) needed
+ * for the DMA SG. Physically contiguous pages are counted as
+ * a single entry.
  * 
  * @sg: DMA SG pointer.
  * 
@@ -77,6 +102,73 @@ struct dma_sg * dma_sg_create(struct dma_block * block, \
  * 
  */
 int dma_sg_get_pages(struct dma_sg * sg);
+
+/**
+ * 
+ * dma_sg_get_nents - Get the number of SG entries needed for the
+ * DMA SG when the size of each entry is limited.
+ * 
+ * @sg: DMA SG pointer.
+ * @max_seg: Maximum size of a SG entry.
+ * @seg_boundary: Segment boundary mask of the device.
+ * 
+ * Return: The number of SG entries needed.
+ * 
+ */
+int dma_sg_get_nents(struct dma_sg * sg, unsigned int max_seg, \
+	unsigned long seg_boundary);
+
+/**
+ * 
+ * dma_sg_get_len - Get the length of the DMA block range described
+ * by the DMA SG.
+ * 
+ * @sg: DMA SG pointer.
+ * 
+ * Return: The length in bytes.
+ * 
+ */
+size_t dma_sg_get_len(struct dma_sg * sg);
+
+/**
+ * 
+ * dma_sg_split_size - Carve a DMA block into DMA SGs of a fixed size
+ * (the last one may be smaller).
+ * 
+ * @block: DMA block pointer.
+ * @size: Size of each DMA SG.
+ * @sgs: Array to store the DMA SGs.
+ * @n: Number of elements of the array.
+ * @gfp: Specific flags to request memory.
+ * 
+ * Return: The number of DMA SGs created or a negative value on error
+ * (the block doesn't fit in the array or there is no memory).
+ * 
+ */
+int dma_sg_split_size(struct dma_block * block, size_t size, \
+	struct dma_sg ** sgs, unsigned int n, gfp_t gfp);
+
+/**
+ * 
+ * dma_sg_split - Carve a DMA block into up to n DMA SGs of similar
+ * size. Each DMA SG but the first one starts at a page boundary of the
+ * memory (the block may start in the middle of a page), so that
+ * different DMA SGs never share a cache line and they can be
+ * transferred in parallel. The offset within the page is taken from
+ * the pages or the buffer of the block: blocks without any of them
+ * (e.g. dma-buf) are split at page boundaries of the block.
+ * 
+ * @block: DMA block pointer.
+ * @sgs: Array to store the DMA SGs.
+ * @n: Number of DMA SGs.
+ * @gfp: Specific flags to request memory.
+ * 
+ * Return: The number of DMA SGs created (it may be less than n
+ * for small blocks) or a negative value on error.
+ * 
+ */
+int dma_sg_split(struct dma_block * block, struct dma_sg ** sgs, \
+	unsigned int n, gfp_t gfp);
 	
 /**
  * 
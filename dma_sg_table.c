@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA SG Table construction functions (implementation).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include <linux/slab.h>
+#include <asm/page.h>
+
+#include "dma_sg_table.h"
+
+/*
+ * Each chained chunk of the SG table takes a single page, so big
+ * tables never need high-order allocations. All the chunks are
+ * allocated up front, once the entries have been counted.
+ */
+#define DMA_SG_TABLE_CHUNK SG_MAX_SINGLE_ALLOC
+
+static struct scatterlist * _dma_sg_table_alloc(unsigned int nents, \
+	gfp_t gfp)
+{
+	return kmalloc_array(nents,sizeof(struct scatterlist),gfp);
+}
+
+static void _dma_sg_table_free(struct scatterlist * sgl, unsigned int nents)
+{
+	kfree(sgl);
+}
+
+static int _dma_sg_table_get_nents(struct list_head * list_dma_sg, \
+	unsigned int max_seg, unsigned long seg_boundary)
+{
+	struct list_head * p;
+	struct dma_sg * dsg;
+	int nents = 0;
+	int r;
+
+	list_for_each(p,list_dma_sg) {
+		dsg = list_entry(p,struct dma_sg,node);
+
+		r = dma_sg_get_nents(dsg,max_seg,seg_boundary);
+		if(r <= 0)
+			return -1;
+
+		nents += r;
+	}
+
+	return nents;
+}
+
+static int _dma_sg_table_setup(struct sg_table * sgt, \
+	struct list_head * list_dma_sg, unsigned int max_seg, \
+	unsigned long seg_boundary)
+{
+	struct scatterlist * sg = sgt->sgl;
+	struct list_head * p;
+	struct dma_sg * dsg;
+	int nents = sgt->nents;
+	int r;
+
+	list_for_each(p,list_dma_sg) {
+		dsg = list_entry(p,struct dma_sg,node);
+
+		r = dma_block_setup_sg(dsg->block,dsg->offset,\
+			dma_sg_get_len(dsg),max_seg,seg_boundary,&sg,nents);
+		if(r < 0)
+			return -1;
+
+		nents -= r;
+	}
+
+	return 0;
+}
+
+int dma_sg_table_create(struct sg_table * sgt, \
+	struct list_head * list_dma_sg, unsigned int max_seg, \
+	unsigned long seg_boundary, struct scatterlist * first_chunk, \
+	unsigned int nents_first_chunk, gfp_t gfp)
+{
+	int nents;
+
+	nents = _dma_sg_table_get_nents(list_dma_sg,max_seg,seg_boundary);
+	if(nents <= 0)
+		return -1;
+
+	if(__sg_alloc_table(sgt,nents,DMA_SG_TABLE_CHUNK,first_chunk, \
+		nents_first_chunk,gfp,_dma_sg_table_alloc)) {
+		dma_sg_table_free(sgt,nents_first_chunk);
+		return -2;
+	}
+
+	if(_dma_sg_table_setup(sgt,list_dma_sg,max_seg,seg_boundary) < 0)
+		return -3;
+
+	return nents;
+}
+
+void dma_sg_table_free(struct sg_table * sgt, \
+	unsigned int nents_first_chunk)
+{
+	__sg_free_table(sgt,DMA_SG_TABLE_CHUNK,nents_first_chunk, \
+		_dma_sg_table_free,sgt->orig_nents);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA SG Table construction functions (header).
+ *
+ * They build the SG table of a list of DMA SGs. They do not depend
+ * on the DMAengine, so they can be built in user space (see tools/).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef DMA_SG_TABLE_H
+#define DMA_SG_TABLE_H
+
+#include <linux/types.h>
+#include <linux/scatterlist.h>
+#include <linux/list.h>
+
+#include "dma_sg.h"
+
+/**
+ *
+ * dma_sg_table_create - Build the SG table of a list of DMA SGs.
+ *
+ * The number of entries is counted first and the whole chain is
+ * allocated at once: the entries that don't fit in first_chunk go to
+ * chained chunks of one page each (no high-order allocations). The
+ * table doesn't grow while it is filled.
+ *
+ * @sgt: SG table.
+ * @list_dma_sg: List of DMA SGs.
+ * @max_seg: Maximum size of a SG entry.
+ * @seg_boundary: Segment boundary mask of the device (no SG entry
+ *	crosses it).
+ * @first_chunk: First chunk of the SG table (it may be NULL).
+ * @nents_first_chunk: Number of entries of the first chunk.
+ * @gfp: Specific flags to request memory.
+ *
+ * Return: The number of SG entries, -1 if the pages of a DMA SG
+ * couldn't be got, -2 if the SG table couldn't be allocated and -3 if
+ * a DMA SG couldn't be set up (the SG table must be freed).
+ *
+ */
+int dma_sg_table_create(struct sg_table * sgt, \
+	struct list_head * list_dma_sg, unsigned int max_seg, \
+	unsigned long seg_boundary, struct scatterlist * first_chunk, \
+	unsigned int nents_first_chunk, gfp_t gfp);
+
+/**
+ *
+ * dma_sg_table_free - Destroy a SG table built by dma_sg_table_create.
+ *
+ * @sgt: SG table.
+ * @nents_first_chunk: Number of entries of the first chunk.
+ *
+ */
+void dma_sg_table_free(struct sg_table * sgt, \
+	unsigned int nents_first_chunk);
+
+#endif /* DMA_SG_TABLE_H */
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA Statistics functions (implementation).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+#include "dma_stats.h"
+
+static const char * const dma_stats_group_names[] = {
+	"chan", "pool",
+};
+
+static const char * const dma_stats_counter_names[] = {
+	"xfers", "bytes", "completed", "errors", "map_failures",
+	"prep_failures", "submit_failures", "inflight",
+};
+
+static const char * const dma_stats_hist_names[] = {
+	"prep", "complete", "pdesc_prep", "pdesc_complete", "pdesc_total",
+};
+
+/* debugfs directories (dma_opl and its groups) */
+static DEFINE_MUTEX(dma_stats_mutex);
+static struct dentry * dma_stats_root;
+static struct dentry * dma_stats_groups[DMA_STATS_NGROUPS];
+static unsigned int dma_stats_users;
+
+/* Channel statistics */
+static LIST_HEAD(dma_stats_chans);
+static DEFINE_SPINLOCK(dma_stats_chans_lock);
+
+static int _dma_stats_counters_show(struct seq_file * s, void * data)
+{
+	struct dma_stats * stats = s->private;
+	unsigned int i;
+
+	for(i = 0; i < DMA_STATS_NCOUNTERS; i++) {
+		if(i == DMA_STATS_INFLIGHT)
+			seq_printf(s,"%s: %lld\n",dma_stats_counter_names[i], \
+				(s64) dma_stats_read(stats,i));
+		else
+			seq_printf(s,"%s: %llu\n",dma_stats_counter_names[i], \
+				dma_stats_read(stats,i));
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(_dma_stats_counters);
+
+static int _dma_stats_latency_show(struct seq_file * s, void * data)
+{
+	struct dma_stats * stats = s->private;
+	u64 hist[DMA_STATS_NBUCKETS];
+	unsigned int cpu;
+	unsigned int i;
+	unsigned int j;
+
+	for(i = 0; i < DMA_STATS_NHISTS; i++) {
+		memset(hist,0,sizeof(hist));
+		for_each_possible_cpu(cpu)
+			for(j = 0; j < DMA_STATS_NBUCKETS; j++)
+				hist[j] += per_cpu_ptr(stats->cpu,cpu)->hist[i][j];
+
+		seq_printf(s,"%s (ns):\n",dma_stats_hist_names[i]);
+		for(j = 0; j < DMA_STATS_NBUCKETS; j++) {
+			if(hist[j] == 0)
+				continue;
+
+			if(j+1 < DMA_STATS_NBUCKETS)
+				seq_printf(s,"  < %llu: %llu\n",1ULL << j,hist[j]);
+			else
+				seq_printf(s,"  >= %llu: %llu\n",1ULL << (j-1),hist[j]);
+		}
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(_dma_stats_latency);
+
+static ssize_t _dma_stats_reset_write(struct file * file, \
+	const char __user * buf, size_t count, loff_t * ppos)
+{
+	dma_stats_reset(file->private_data);
+
+	return count;
+}
+
+static const struct file_operations _dma_stats_reset_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.write = _dma_stats_reset_write,
+	.llseek = noop_llseek,
+};
+
+static struct dentry * _dma_stats_get_group(enum dma_stats_group group)
+{
+	unsigned int i;
+
+	if(dma_stats_users++ == 0) {
+		dma_stats_root = debugfs_create_dir("dma_opl",NULL);
+		for(i = 0; i < DMA_STATS_NGROUPS; i++)
+			dma_stats_groups[i] = debugfs_create_dir( \
+				dma_stats_group_names[i],dma_stats_root);
+	}
+
+	return dma_stats_groups[group];
+}
+
+static void _dma_stats_put_group(void)
+{
+	if(--dma_stats_users == 0) {
+		debugfs_remove(dma_stats_root);
+		dma_stats_root = NULL;
+	}
+}
+
+struct dma_stats * dma_stats_create(enum dma_stats_group group, \
+	const char * name)
+{
+	struct dma_stats * stats = NULL;
+	struct dentry * parent;
+
+	stats = kzalloc(sizeof(*stats),GFP_KERNEL);
+	if(stats == NULL)
+		return NULL;
+
+	stats->cpu = alloc_percpu(struct dma_stats_cpu);
+	if(stats->cpu == NULL) {
+		kfree(stats);
+		return NULL;
+	}
+
+	INIT_LIST_HEAD(&stats->node);
+
+	/* debugfs errors are not fatal: the counters still work */
+	mutex_lock(&dma_stats_mutex);
+	parent = _dma_stats_get_group(group);
+	stats->dir = debugfs_create_dir(name,parent);
+	debugfs_create_file("counters",0444,stats->dir,stats, \
+		&_dma_stats_counters_fops);
+	debugfs_create_file("latency",0444,stats->dir,stats, \
+		&_dma_stats_latency_fops);
+	debugfs_create_file("reset",0200,stats->dir,stats, \
+		&_dma_stats_reset_fops);
+	mutex_unlock(&dma_stats_mutex);
+
+	return stats;
+}
+
+u64 dma_stats_read(struct dma_stats * stats, enum dma_stats_counter counter)
+{
+	unsigned int cpu;
+	u64 val = 0;
+
+	for_each_possible_cpu(cpu)
+		val += per_cpu_ptr(stats->cpu,cpu)->cnt[counter];
+
+	return val;
+}
+
+void dma_stats_reset(struct dma_stats * stats)
+{
+	struct dma_stats_cpu * c;
+	unsigned int cpu;
+	unsigned int i;
+
+	for_each_possible_cpu(cpu) {
+		c = per_cpu_ptr(stats->cpu,cpu);
+
+		for(i = 0; i < DMA_STATS_NCOUNTERS; i++)
+			if(i != DMA_STATS_INFLIGHT)
+				WRITE_ONCE(c->cnt[i],0);
+		memset(c->hist,0,sizeof(c->hist));
+	}
+}
+
+void dma_stats_free(struct dma_stats * stats)
+{
+	if(stats != NULL) {
+		mutex_lock(&dma_stats_mutex);
+		debugfs_remove(stats->dir);
+		_dma_stats_put_group();
+		mutex_unlock(&dma_stats_mutex);
+
+		free_percpu(stats->cpu);
+		kfree(stats);
+	}
+}
+
+int dma_stats_chan_register(struct dma_chan * chan)
+{
+	struct dma_stats * stats;
+	unsigned long flags;
+
+	if(dma_stats_chan_find(chan) != NULL)
+		return -1;
+
+	stats = dma_stats_create(DMA_STATS_CHAN,dma_chan_name(chan));
+	if(stats == NULL)
+		return -2;
+
+	stats->chan = chan;
+
+	spin_lock_irqsave(&dma_stats_chans_lock,flags);
+	list_add_tail(&stats->node,&dma_stats_chans);
+	spin_unlock_irqrestore(&dma_stats_chans_lock,flags);
+
+	return 0;
+}
+
+struct dma_stats * dma_stats_chan_find(struct dma_chan * chan)
+{
+	struct dma_stats * stats = NULL;
+	struct dma_stats * p;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dma_stats_chans_lock,flags);
+	list_for_each_entry(p,&dma_stats_chans,node) {
+		if(p->chan == chan) {
+			stats = p;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&dma_stats_chans_lock,flags);
+
+	return stats;
+}
+
+void dma_stats_chan_unregister(struct dma_chan * chan)
+{
+	struct dma_stats * stats = dma_stats_chan_find(chan);
+	unsigned long flags;
+
+	if(stats != NULL) {
+		spin_lock_irqsave(&dma_stats_chans_lock,flags);
+		list_del(&stats->node);
+		spin_unlock_irqrestore(&dma_stats_chans_lock,flags);
+
+		dma_stats_free(stats);
+	}
+}
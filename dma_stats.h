@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA Statistics functions (header).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef DMA_STATS_H
+#define DMA_STATS_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/percpu.h>
+#include <linux/bitops.h>
+#include <linux/dmaengine.h>
+
+/**
+ *
+ * DMA Statistics counters.
+ *
+ * @DMA_STATS_XFERS: Submitted transfers.
+ * @DMA_STATS_BYTES: Submitted bytes.
+ * @DMA_STATS_COMPLETED: Completed transfers.
+ * @DMA_STATS_ERRORS: Transfers completed with an error.
+ * @DMA_STATS_MAP_FAILURES: SG tables that couldn't be built or mapped.
+ * @DMA_STATS_PREP_FAILURES: Descriptors that couldn't be prepared.
+ * @DMA_STATS_SUBMIT_FAILURES: Descriptors that couldn't be submitted.
+ * @DMA_STATS_INFLIGHT: Transfers in flight (submitted - completed).
+ *
+ */
+enum dma_stats_counter {
+	DMA_STATS_XFERS,
+	DMA_STATS_BYTES,
+	DMA_STATS_COMPLETED,
+	DMA_STATS_ERRORS,
+	DMA_STATS_MAP_FAILURES,
+	DMA_STATS_PREP_FAILURES,
+	DMA_STATS_SUBMIT_FAILURES,
+	DMA_STATS_INFLIGHT,
+	DMA_STATS_NCOUNTERS,
+};
+
+/**
+ *
+ * DMA Statistics latency histograms.
+ *
+ * @DMA_STATS_LAT_PREP: From the prep to the submit of a transfer.
+ * @DMA_STATS_LAT_COMPLETE: From the submit to the completion of a
+ *	transfer.
+ * @DMA_STATS_LAT_PDESC_PREP: From the prep (map included) to the
+ *	submit of a packet descriptor.
+ * @DMA_STATS_LAT_PDESC_COMPLETE: From the submit to the completion of
+ *	a packet descriptor.
+ * @DMA_STATS_LAT_PDESC_TOTAL: From the creation to the completion of
+ *	a packet descriptor.
+ *
+ * The packet descriptor histograms are only fed by the descriptors
+ * with timestamps (see pdesc_tstamp_enable).
+ *
+ */
+enum dma_stats_hist {
+	DMA_STATS_LAT_PREP,
+	DMA_STATS_LAT_COMPLETE,
+	DMA_STATS_LAT_PDESC_PREP,
+	DMA_STATS_LAT_PDESC_COMPLETE,
+	DMA_STATS_LAT_PDESC_TOTAL,
+	DMA_STATS_NHISTS,
+};
+
+/**
+ *
+ * DMA Statistics groups (debugfs directories).
+ *
+ * @DMA_STATS_CHAN: DMA channels (dma_opl/chan).
+ * @DMA_STATS_POOL: Packet descriptor pools (dma_opl/pool).
+ *
+ */
+enum dma_stats_group {
+	DMA_STATS_CHAN,
+	DMA_STATS_POOL,
+	DMA_STATS_NGROUPS,
+};
+
+/*
+ * Bucket k of a histogram counts the latencies in [2^(k-1),2^k) ns.
+ * The last bucket counts everything above.
+ */
+#define DMA_STATS_NBUCKETS 32
+
+struct dma_stats_cpu {
+	u64 cnt[DMA_STATS_NCOUNTERS];
+	u64 hist[DMA_STATS_NHISTS][DMA_STATS_NBUCKETS];
+};
+
+/**
+ *
+ * DMA Statistics structure. The counters are per-CPU, so they are
+ * updated without atomics or shared cache lines, and they are only
+ * summed when they are read from debugfs.
+ *
+ */
+struct dma_stats {
+	struct dma_stats_cpu __percpu * cpu;
+
+	/* debugfs directory */
+	struct dentry * dir;
+
+	/* Channel of the statistics (channel statistics only) */
+	struct dma_chan * chan;
+	struct list_head node;
+};
+
+static inline void dma_stats_add(struct dma_stats * stats, \
+	enum dma_stats_counter counter, u64 val)
+{
+	if(stats != NULL)
+		this_cpu_add(stats->cpu->cnt[counter],val);
+}
+
+static inline void dma_stats_inc(struct dma_stats * stats, \
+	enum dma_stats_counter counter)
+{
+	dma_stats_add(stats,counter,1);
+}
+
+static inline void dma_stats_dec(struct dma_stats * stats, \
+	enum dma_stats_counter counter)
+{
+	dma_stats_add(stats,counter,-1);
+}
+
+static inline void dma_stats_lat(struct dma_stats * stats, \
+	enum dma_stats_hist hist, u64 ns)
+{
+	if(stats != NULL)
+		this_cpu_inc(stats->cpu->hist[hist] \
+			[min_t(unsigned int,fls64(ns),DMA_STATS_NBUCKETS-1)]);
+}
+
+/**
+ *
+ * dma_stats_create - Create a new DMA Statistics structure and its
+ * debugfs directory (dma_opl/<group>/<name>). It must be called from
+ * process context.
+ *
+ * @group: Group of the statistics.
+ * @name: Name of the statistics.
+ *
+ * Return: A DMA Statistics structure.
+ *
+ */
+struct dma_stats * dma_stats_create(enum dma_stats_group group, \
+	const char * name);
+
+/**
+ *
+ * dma_stats_read - Sum a counter over all the CPUs.
+ *
+ * @stats: DMA Statistics pointer.
+ * @counter: Counter.
+ *
+ * Return: The value of the counter.
+ *
+ */
+u64 dma_stats_read(struct dma_stats * stats, enum dma_stats_counter counter);
+
+/**
+ *
+ * dma_stats_reset - Clear all the counters and histograms. The
+ * transfers in flight are kept.
+ *
+ * @stats: DMA Statistics pointer.
+ *
+ */
+void dma_stats_reset(struct dma_stats * stats);
+
+/**
+ *
+ * dma_stats_free - Destroy a DMA Statistics structure.
+ *
+ * @stats: DMA Statistics pointer.
+ *
+ */
+void dma_stats_free(struct dma_stats * stats);
+
+/**
+ *
+ * dma_stats_chan_register - Enable the statistics of a DMA channel
+ * (dma_opl/chan/<channel name>). They are updated by the DMA Xfers
+ * created after this call.
+ *
+ * @chan: DMA channel.
+ *
+ * Return: 0 if success and an error code otherwise.
+ *
+ */
+int dma_stats_chan_register(struct dma_chan * chan);
+
+/**
+ *
+ * dma_stats_chan_find - Get the statistics of a DMA channel.
+ *
+ * @chan: DMA channel.
+ *
+ * Return: The DMA Statistics or NULL if they are not enabled.
+ *
+ */
+struct dma_stats * dma_stats_chan_find(struct dma_chan * chan);
+
+/**
+ *
+ * dma_stats_chan_unregister - Disable the statistics of a DMA channel.
+ * The DMA Xfers of the channel must have been freed.
+ *
+ * @chan: DMA channel.
+ *
+ */
+void dma_stats_chan_unregister(struct dma_chan * chan);
+
+#endif /* DMA_STATS_H */
@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA Stream functions (implementation).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include <linux/slab.h>
+
+#include "dma_stream.h"
+
+struct dma_stream * dma_stream_create(struct dma_chan * dma_chan, \
+	struct dma_slave_config * dma_config, struct device * hwdev, \
+	enum dma_transfer_direction dma_dir, unsigned int depth, \
+	dma_stream_done_t done_f, gfp_t gfp)
+{
+	struct dma_stream * stream = NULL;
+
+	if(depth == 0)
+		return NULL;
+
+	stream = kzalloc(sizeof(*stream),gfp);
+	if(stream != NULL) {
+		stream->dma_chan = dma_chan;
+		stream->dma_config = *dma_config;
+		stream->dma_dir = dma_dir;
+		stream->flags = DMA_PREP_INTERRUPT | DMA_CTRL_ACK;
+		stream->hwdev = hwdev;
+		stream->depth = depth;
+		stream->done_f = done_f;
+
+		INIT_LIST_HEAD(&stream->list_ready);
+		INIT_LIST_HEAD(&stream->list_inflight);
+		spin_lock_init(&stream->lock);
+	}
+
+	return stream;
+}
+
+static void _dma_stream_buf_release(struct dma_stream_buf * buf, \
+	int status)
+{
+	struct dma_stream * stream = buf->stream;
+
+	dma_xfer_clear_sg(buf->xfer);
+	dma_xfer_free(buf->xfer);
+	dma_sg_free(buf->sg);
+
+	stream->done_f(stream,buf->block,buf->priv,status);
+
+	kfree(buf);
+}
+
+/* Submit the prepared buffers while there are free slots */
+static void _dma_stream_kick(struct dma_stream * stream)
+{
+	struct dma_stream_buf * buf;
+
+	while(stream->inflight < stream->depth && \
+		!list_empty(&stream->list_ready)) {
+		buf = list_first_entry(&stream->list_ready, \
+			struct dma_stream_buf,node);
+
+		list_move_tail(&buf->node,&stream->list_inflight);
+		stream->inflight++;
+
+		dma_xfer_start(buf->xfer);
+	}
+}
+
+/* Status of a buffer from the result recorded by the DMA Xfer */
+static int _dma_stream_buf_status(struct dma_stream_buf * buf)
+{
+	if(!completion_done(&buf->xfer->done))
+		return -1;
+
+	return (buf->xfer->dma_result == DMA_TRANS_NOERROR) ? 0 : -1;
+}
+
+static void _dma_stream_callback(void * param)
+{
+	struct dma_stream_buf * buf = param;
+	struct dma_stream * stream = buf->stream;
+	unsigned long flags;
+
+	spin_lock_irqsave(&stream->lock,flags);
+
+	/* The buffer belongs to dma_stream_free now */
+	if(stream->closing) {
+		spin_unlock_irqrestore(&stream->lock,flags);
+		return;
+	}
+
+	list_del(&buf->node);
+	stream->inflight--;
+	_dma_stream_kick(stream);
+	spin_unlock_irqrestore(&stream->lock,flags);
+
+	_dma_stream_buf_release(buf,_dma_stream_buf_status(buf));
+}
+
+int dma_stream_queue(struct dma_stream * stream, \
+	struct dma_block * block, void * priv, gfp_t gfp)
+{
+	struct dma_stream_buf * buf;
+	unsigned long flags;
+	int r;
+
+	buf = kzalloc(sizeof(*buf),gfp);
+	if(buf == NULL)
+		return -1;
+
+	buf->stream = stream;
+	buf->block = block;
+	buf->priv = priv;
+
+	buf->sg = dma_sg_create(block,gfp);
+	buf->xfer = dma_xfer_create(stream->dma_chan,&stream->dma_config, \
+		stream->hwdev,gfp);
+	if(buf->sg == NULL || buf->xfer == NULL) {
+		r = -1;
+		goto err;
+	}
+
+	dma_xfer_add_sg(buf->xfer,buf->sg);
+
+	r = dma_xfer_map_sg(buf->xfer, \
+		(stream->dma_dir == DMA_MEM_TO_DEV) ? \
+			DMA_TO_DEVICE : DMA_FROM_DEVICE, \
+		gfp);
+	if(r != 0)
+		goto err;
+
+	r = dma_xfer_prep_start_sg(buf->xfer,stream->dma_dir, \
+		_dma_stream_callback,buf,stream->flags,NULL);
+	if(r != 0)
+		goto err;
+
+	spin_lock_irqsave(&stream->lock,flags);
+	list_add_tail(&buf->node,&stream->list_ready);
+	_dma_stream_kick(stream);
+	spin_unlock_irqrestore(&stream->lock,flags);
+
+	return 0;
+
+err:
+	/* The buffer is given back to the caller: no done callback */
+	if(buf->xfer != NULL) {
+		dma_xfer_clear_sg(buf->xfer);
+		dma_xfer_free(buf->xfer);
+	}
+	dma_sg_free(buf->sg);
+	kfree(buf);
+
+	return r;
+}
+
+void dma_stream_free(struct dma_stream * stream)
+{
+	struct dma_stream_buf * buf;
+	struct dma_stream_buf * aux;
+	unsigned long flags;
+	LIST_HEAD(list_cancel);
+
+	if(stream == NULL)
+		return;
+
+	spin_lock_irqsave(&stream->lock,flags);
+	stream->closing = 1;
+
+	/*
+	 * The prepared buffers are submitted without being issued: the
+	 * drivers only release the submitted descriptors on terminate.
+	 */
+	list_for_each_entry(buf,&stream->list_ready,node)
+		dma_xfer_submit(buf->xfer);
+
+	list_splice_tail_init(&stream->list_inflight,&list_cancel);
+	list_splice_tail_init(&stream->list_ready,&list_cancel);
+	stream->inflight = 0;
+	spin_unlock_irqrestore(&stream->lock,flags);
+
+	/* No DMA callback runs after this */
+	dmaengine_terminate_sync(stream->dma_chan);
+
+	list_for_each_entry_safe(buf,aux,&list_cancel,node) {
+		list_del(&buf->node);
+		_dma_stream_buf_release(buf,_dma_stream_buf_status(buf));
+	}
+
+	kfree(stream);
+}
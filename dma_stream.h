@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA Stream functions (header).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef DMA_STREAM_H
+#define DMA_STREAM_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/dmaengine.h>
+#include <linux/device.h>
+
+#include "dma_xfer.h"
+
+struct dma_stream;
+
+/**
+ *
+ * DMA Stream done callback. It is called (from the DMA callback
+ * context) when a buffer has been transferred and unmapped.
+ *
+ * @stream: DMA Stream pointer.
+ * @block: DMA block of the buffer.
+ * @priv: Private pointer given with the buffer.
+ * @status: 0 if the buffer has been transferred or a negative
+ * 	value if it has failed or it has been cancelled.
+ *
+ */
+typedef void (*dma_stream_done_t)(struct dma_stream * stream, \
+	struct dma_block * block, void * priv, int status);
+
+/**
+ *
+ * DMA Stream buffer structure. It is the DMA Xfer of a queued buffer.
+ *
+ */
+struct dma_stream_buf {
+	/* Owner stream */
+	struct dma_stream * stream;
+
+	/* Data */
+	struct dma_block * block;
+	struct dma_sg * sg;
+	struct dma_xfer * xfer;
+
+	/* Private pointer for the done callback */
+	void * priv;
+
+	/* Ready/in-flight linked list */
+	struct list_head node;
+};
+
+/**
+ *
+ * DMA Stream structure. It keeps up to depth DMA Xfers in flight on
+ * a channel for sequential streaming (acquisition, bulk TX...).
+ *
+ * The buffers are mapped and prepared as soon as they are queued, so
+ * the next DMA Xfer is submitted from the DMA callback of the previous
+ * one without any mapping or preparation in between.
+ *
+ */
+struct dma_stream {
+	/* DMAengine stuff */
+	struct dma_chan * dma_chan;
+	struct dma_slave_config dma_config;
+	enum dma_transfer_direction dma_dir;
+	unsigned long flags;
+
+	/* Reference to internal Linux dev */
+	struct device * hwdev;
+
+	/* Maximum number of DMA Xfers in flight */
+	unsigned int depth;
+	unsigned int inflight;
+
+	/* Prepared buffers waiting for a free slot */
+	struct list_head list_ready;
+
+	/* Submitted buffers */
+	struct list_head list_inflight;
+
+	/* Done callback */
+	dma_stream_done_t done_f;
+
+	/* dma_stream_free owns the buffers (the callbacks are ignored) */
+	int closing;
+
+	spinlock_t lock;
+};
+
+/**
+ *
+ * dma_stream_create - Create a new DMA Stream.
+ *
+ * @dma_chan: DMA channel.
+ * @dma_config: DMA configuration settings.
+ * @hwdev: reference to internal Linux device.
+ * @dma_dir: DMA direction (DMA_MEM_TO_DEV or DMA_DEV_TO_MEM).
+ * @depth: Maximum number of DMA Xfers in flight.
+ * @done_f: Done callback.
+ * @gfp: Specific flags to request memory.
+ *
+ * Return: A DMA Stream.
+ *
+ */
+struct dma_stream * dma_stream_create(struct dma_chan * dma_chan, \
+	struct dma_slave_config * dma_config, struct device * hwdev, \
+	enum dma_transfer_direction dma_dir, unsigned int depth, \
+	dma_stream_done_t done_f, gfp_t gfp);
+
+/**
+ *
+ * dma_stream_queue - Map and prepare a buffer and queue it in the DMA
+ * Stream. It is submitted as soon as there is a free slot. It can be
+ * called from the done callback (with an atomic gfp) to recycle the
+ * buffer.
+ *
+ * The buffers that are prepared ahead take DMA descriptors from the
+ * channel, so the caller should not queue many more than depth.
+ *
+ * @stream: DMA Stream pointer.
+ * @block: DMA block.
+ * @priv: Private pointer for the done callback.
+ * @gfp: Specific flags to request memory.
+ *
+ * Return: 0 if success and an error code otherwise.
+ *
+ */
+int dma_stream_queue(struct dma_stream * stream, \
+	struct dma_block * block, void * priv, gfp_t gfp);
+
+/**
+ *
+ * dma_stream_free - Destroy a DMA Stream. The channel is terminated
+ * and the buffers that are still queued are released (the done
+ * callback is called with a negative status, unless the buffer has
+ * been transferred before the channel was terminated).
+ *
+ * @stream: DMA Stream pointer.
+ *
+ */
+void dma_stream_free(struct dma_stream * stream);
+
+#endif /* DMA_STREAM_H */
@@ -0,0 +1,747 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * Software DMA engine (implementation).
+ *
+ * It is a dmaengine provider whose transfers are performed by the CPU,
+ * so the DMA Xfers, Operations and packet descriptors can be tested and
+ * benchmarked without a DMA controller (e.g. in a virtual machine).
+ *
+ * The device side of the slave transfers is emulated: DEV_TO_MEM
+ * transfers write a byte counter and MEM_TO_DEV transfers only read the
+ * memory. The DMA addresses must be physical addresses (dma-direct
+ * without IOMMU), since the buffers are accessed through their pages.
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/highmem.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+#include <linux/platform_device.h>
+#include <linux/dma-mapping.h>
+
+#include "dma_sw_engine.h"
+
+/* Bytes that are transferred between two checks of the descriptor */
+#define DMA_SW_CHUNK (16*PAGE_SIZE)
+
+static unsigned int nr_chans = 4;
+module_param(nr_chans,uint,0444);
+MODULE_PARM_DESC(nr_chans,"Number of DMA channels");
+
+static unsigned int latency_us;
+module_param(latency_us,uint,0644);
+MODULE_PARM_DESC(latency_us,"Start latency of each descriptor (us)");
+
+static unsigned int bandwidth;
+module_param(bandwidth,uint,0644);
+MODULE_PARM_DESC(bandwidth,"Bandwidth of each channel (MB/s, 0: no limit)");
+
+static unsigned int max_sg;
+module_param(max_sg,uint,0444);
+MODULE_PARM_DESC(max_sg,"Maximum number of SG entries per descriptor (0: no limit, see dma_xfer_set_limits)");
+
+static unsigned int max_seg = 65536;
+module_param(max_seg,uint,0444);
+MODULE_PARM_DESC(max_seg,"Maximum size of a SG entry (bytes)");
+
+static unsigned int err_every;
+module_param(err_every,uint,0644);
+MODULE_PARM_DESC(err_every,"Fail one of every err_every descriptors (0: never)");
+
+struct dma_sw_seg {
+	dma_addr_t addr;
+	size_t len;
+};
+
+struct dma_sw_desc {
+	struct dma_async_tx_descriptor tx;
+	enum dma_transfer_direction dir;
+
+	/* memcpy destination (the source is the first segment) */
+	dma_addr_t dst;
+
+	/* Size and position of the transfer (bytes) */
+	size_t len;
+	size_t pos;
+	u64 total;
+
+	/* Cyclic transfer */
+	int cyclic;
+	size_t period_len;
+
+	/* Injected error, bytes left when it failed and terminated descriptor */
+	enum dmaengine_tx_result result;
+	int failed;
+	size_t residue;
+	int started;
+	int aborted;
+	ktime_t start;
+
+	/* Prepared/submitted/issued linked list */
+	struct list_head node;
+
+	unsigned int nsegs;
+	struct dma_sw_seg segs[];
+};
+
+struct dma_sw_chan {
+	struct dma_chan chan;
+	struct dma_slave_config config;
+
+	/* Descriptors: prepared, submitted, issued and the one in progress */
+	struct list_head list_prepared;
+	struct list_head list_submitted;
+	struct list_head list_issued;
+	struct dma_sw_desc * active;
+
+	/* Last descriptor that has failed and its residue */
+	dma_cookie_t error_cookie;
+	size_t error_residue;
+
+	/* Emulated device */
+	u8 dev_data;
+	unsigned long ndescs;
+
+	/* The transfers are performed by this work */
+	struct work_struct work;
+
+	spinlock_t lock;
+};
+
+struct dma_sw_engine {
+	struct platform_device * pdev;
+	struct dma_device dma_dev;
+	struct workqueue_struct * wq;
+	struct dma_sw_chan * chans;
+};
+
+static struct dma_sw_engine * dma_sw;
+
+static struct dma_sw_chan * _dma_sw_chan(struct dma_chan * chan)
+{
+	return container_of(chan,struct dma_sw_chan,chan);
+}
+
+static struct dma_sw_desc * _dma_sw_desc(struct dma_async_tx_descriptor * tx)
+{
+	return container_of(tx,struct dma_sw_desc,tx);
+}
+
+/* Map the part of a DMA address range that is inside one page */
+static void * _dma_sw_map(dma_addr_t addr, size_t * len)
+{
+	unsigned long pfn = PHYS_PFN(addr);
+	size_t off = offset_in_page(addr);
+
+	if(!pfn_valid(pfn))
+		return NULL;
+
+	*len = min_t(size_t,*len,PAGE_SIZE-off);
+
+	return kmap_local_page(pfn_to_page(pfn))+off;
+}
+
+static int _dma_sw_copy_page(struct dma_sw_chan * sc, \
+	struct dma_sw_desc * desc, dma_addr_t addr, size_t off, size_t * len)
+{
+	void * vaddr;
+	void * dst;
+	size_t dst_len;
+	size_t i;
+	u8 sum = 0;
+
+	vaddr = _dma_sw_map(addr,len);
+	if(vaddr == NULL)
+		return -1;
+
+	switch(desc->dir) {
+	case DMA_DEV_TO_MEM:
+		for(i = 0; i < *len; i++)
+			((u8 *) vaddr)[i] = sc->dev_data++;
+		break;
+
+	case DMA_MEM_TO_DEV:
+		for(i = 0; i < *len; i++)
+			sum += ((u8 *) vaddr)[i];
+		sc->dev_data += sum;
+		break;
+
+	default:
+		dst_len = *len;
+		dst = _dma_sw_map(desc->dst+off,&dst_len);
+		if(dst == NULL) {
+			kunmap_local(vaddr);
+			return -1;
+		}
+		*len = dst_len;
+		memcpy(dst,vaddr,*len);
+		kunmap_local(dst);
+		break;
+	}
+
+	kunmap_local(vaddr);
+
+	return 0;
+}
+
+/* Transfer len bytes from the position pos of the descriptor */
+static int _dma_sw_transfer(struct dma_sw_chan * sc, \
+	struct dma_sw_desc * desc, size_t pos, size_t len)
+{
+	struct dma_sw_seg * seg = desc->segs;
+	size_t off = pos;
+	size_t n;
+
+	while(off >= seg->len) {
+		off -= seg->len;
+		seg++;
+	}
+
+	while(len > 0) {
+		n = min(len,seg->len-off);
+		if(_dma_sw_copy_page(sc,desc,seg->addr+off,pos,&n) != 0)
+			return -1;
+
+		pos += n;
+		off += n;
+		len -= n;
+
+		if(off == seg->len) {
+			off = 0;
+			seg++;
+		}
+	}
+
+	return 0;
+}
+
+static void _dma_sw_callback(struct dma_sw_desc * desc, \
+	enum dmaengine_tx_result result, u32 residue)
+{
+	struct dmaengine_result res = {
+		.result = result,
+		.residue = residue,
+	};
+
+	if(!(desc->tx.flags & DMA_PREP_INTERRUPT))
+		return;
+
+	if(desc->tx.callback_result != NULL)
+		desc->tx.callback_result(desc->tx.callback_param,&res);
+	else if(desc->tx.callback != NULL)
+		desc->tx.callback(desc->tx.callback_param);
+}
+
+/* Start latency and error injection */
+static void _dma_sw_start(struct dma_sw_chan * sc, struct dma_sw_desc * desc)
+{
+	unsigned int every = READ_ONCE(err_every);
+
+	if(latency_us > 0)
+		fsleep(latency_us);
+
+	if(every > 0 && (++sc->ndescs % every) == 0)
+		desc->result = (desc->dir == DMA_DEV_TO_MEM) ? \
+			DMA_TRANS_WRITE_FAILED : DMA_TRANS_READ_FAILED;
+
+	desc->start = ktime_get();
+	desc->started = 1;
+}
+
+/* Keep the bandwidth of the channel under the limit */
+static void _dma_sw_pace(struct dma_sw_desc * desc)
+{
+	unsigned int bw = READ_ONCE(bandwidth);
+	s64 ahead;
+
+	if(bw == 0)
+		return;
+
+	/* bytes/(MB/s) = us, i.e. bytes*1000/bw ns */
+	ahead = div_u64(desc->total*1000,bw)- \
+		ktime_to_ns(ktime_sub(ktime_get(),desc->start));
+	if(ahead > NSEC_PER_USEC)
+		fsleep(div_s64(ahead,NSEC_PER_USEC));
+}
+
+/*
+ * Perform a chunk of the descriptor. It returns 1 when the descriptor
+ * has completed (or a period of a cyclic one).
+ */
+static int _dma_sw_step(struct dma_sw_chan * sc, struct dma_sw_desc * desc)
+{
+	size_t end = desc->cyclic ? \
+		desc->pos-(desc->pos % desc->period_len)+desc->period_len : \
+		desc->len;
+	size_t n = min_t(size_t,end-desc->pos,DMA_SW_CHUNK);
+	unsigned long flags;
+
+	if(desc->result == DMA_TRANS_NOERROR && \
+		_dma_sw_transfer(sc,desc,desc->pos,n) != 0)
+		desc->result = DMA_TRANS_ABORTED;
+
+	/* A failed descriptor completes at once */
+	if(desc->result != DMA_TRANS_NOERROR)
+		n = end-desc->pos;
+
+	desc->total += n;
+	_dma_sw_pace(desc);
+
+	spin_lock_irqsave(&sc->lock,flags);
+	if(desc->result != DMA_TRANS_NOERROR && !desc->failed) {
+		/* The chunk that failed is counted as not moved */
+		desc->failed = 1;
+		desc->residue = desc->len-desc->pos;
+	}
+	desc->pos += n;
+	if(desc->pos == desc->len)
+		desc->pos = 0;
+	spin_unlock_irqrestore(&sc->lock,flags);
+
+	return (desc->pos % (desc->cyclic ? desc->period_len : desc->len)) == 0;
+}
+
+static void _dma_sw_work(struct work_struct * work)
+{
+	struct dma_sw_chan * sc = container_of(work,struct dma_sw_chan,work);
+	struct dma_sw_desc * desc = NULL;
+	enum dmaengine_tx_result result;
+	unsigned long flags;
+	int done;
+
+	for(;;) {
+		spin_lock_irqsave(&sc->lock,flags);
+
+		/* Terminated while it was in progress */
+		if(desc != NULL && desc->aborted) {
+			spin_unlock_irqrestore(&sc->lock,flags);
+			kfree(desc);
+			desc = NULL;
+			spin_lock_irqsave(&sc->lock,flags);
+		}
+
+		if(desc == NULL) {
+			desc = list_first_entry_or_null(&sc->list_issued, \
+				struct dma_sw_desc,node);
+			if(desc == NULL) {
+				spin_unlock_irqrestore(&sc->lock,flags);
+				return;
+			}
+
+			list_del(&desc->node);
+			sc->active = desc;
+		}
+
+		spin_unlock_irqrestore(&sc->lock,flags);
+
+		if(!desc->started)
+			_dma_sw_start(sc,desc);
+
+		done = _dma_sw_step(sc,desc);
+		if(!done)
+			continue;
+
+		result = desc->result;
+
+		spin_lock_irqsave(&sc->lock,flags);
+		if(desc->aborted) {
+			spin_unlock_irqrestore(&sc->lock,flags);
+			continue;
+		}
+
+		/* A cyclic transfer only completes if it fails */
+		if(!desc->cyclic || result != DMA_TRANS_NOERROR) {
+			sc->chan.completed_cookie = desc->tx.cookie;
+			if(result != DMA_TRANS_NOERROR) {
+				sc->error_cookie = desc->tx.cookie;
+				sc->error_residue = desc->residue;
+			}
+			sc->active = NULL;
+		}
+		spin_unlock_irqrestore(&sc->lock,flags);
+
+		_dma_sw_callback(desc,result, \
+			(result != DMA_TRANS_NOERROR) ? desc->residue : 0);
+
+		if(desc->cyclic && result == DMA_TRANS_NOERROR)
+			continue;
+
+		kfree(desc);
+		desc = NULL;
+	}
+}
+
+static dma_cookie_t _dma_sw_tx_submit(struct dma_async_tx_descriptor * tx)
+{
+	struct dma_sw_chan * sc = _dma_sw_chan(tx->chan);
+	struct dma_sw_desc * desc = _dma_sw_desc(tx);
+	unsigned long flags;
+	dma_cookie_t cookie;
+
+	spin_lock_irqsave(&sc->lock,flags);
+
+	cookie = sc->chan.cookie+1;
+	if(cookie < DMA_MIN_COOKIE)
+		cookie = DMA_MIN_COOKIE;
+	sc->chan.cookie = cookie;
+	tx->cookie = cookie;
+
+	list_move_tail(&desc->node,&sc->list_submitted);
+
+	spin_unlock_irqrestore(&sc->lock,flags);
+
+	return cookie;
+}
+
+static struct dma_sw_desc * _dma_sw_desc_alloc(struct dma_chan * chan, \
+	unsigned int nsegs, enum dma_transfer_direction dir, \
+	unsigned long flags)
+{
+	struct dma_sw_chan * sc = _dma_sw_chan(chan);
+	struct dma_sw_desc * desc;
+	unsigned long lflags;
+
+	desc = kzalloc(struct_size(desc,segs,nsegs),GFP_NOWAIT);
+	if(desc == NULL)
+		return NULL;
+
+	dma_async_tx_descriptor_init(&desc->tx,chan);
+	desc->tx.tx_submit = _dma_sw_tx_submit;
+	desc->tx.flags = flags;
+	desc->dir = dir;
+	desc->nsegs = nsegs;
+	desc->result = DMA_TRANS_NOERROR;
+
+	/* Released on terminate if it is never submitted */
+	spin_lock_irqsave(&sc->lock,lflags);
+	list_add_tail(&desc->node,&sc->list_prepared);
+	spin_unlock_irqrestore(&sc->lock,lflags);
+
+	return desc;
+}
+
+/* Release a descriptor that could not be prepared */
+static void _dma_sw_desc_discard(struct dma_sw_desc * desc)
+{
+	struct dma_sw_chan * sc = _dma_sw_chan(desc->tx.chan);
+	unsigned long flags;
+
+	spin_lock_irqsave(&sc->lock,flags);
+	list_del(&desc->node);
+	spin_unlock_irqrestore(&sc->lock,flags);
+
+	kfree(desc);
+}
+
+static struct dma_async_tx_descriptor * _dma_sw_prep_slave_sg( \
+	struct dma_chan * chan, struct scatterlist * sgl, \
+	unsigned int sg_len, enum dma_transfer_direction dir, \
+	unsigned long flags, void * context)
+{
+	struct dma_sw_desc * desc;
+	struct scatterlist * sg;
+	unsigned int i;
+
+	if(!is_slave_direction(dir) || sg_len == 0)
+		return NULL;
+
+	/* Descriptor limits of the engine */
+	if(max_sg > 0 && sg_len > max_sg)
+		return NULL;
+
+	desc = _dma_sw_desc_alloc(chan,sg_len,dir,flags);
+	if(desc == NULL)
+		return NULL;
+
+	for_each_sg(sgl,sg,sg_len,i) {
+		if(sg_dma_len(sg) == 0 || sg_dma_len(sg) > max_seg) {
+			_dma_sw_desc_discard(desc);
+			return NULL;
+		}
+
+		desc->segs[i].addr = sg_dma_address(sg);
+		desc->segs[i].len = sg_dma_len(sg);
+		desc->len += sg_dma_len(sg);
+	}
+
+	return &desc->tx;
+}
+
+static struct dma_async_tx_descriptor * _dma_sw_prep_dma_cyclic( \
+	struct dma_chan * chan, dma_addr_t buf_addr, size_t buf_len, \
+	size_t period_len, enum dma_transfer_direction dir, \
+	unsigned long flags)
+{
+	struct dma_sw_desc * desc;
+
+	if(!is_slave_direction(dir) || period_len == 0 || \
+		buf_len == 0 || (buf_len % period_len) != 0)
+		return NULL;
+
+	desc = _dma_sw_desc_alloc(chan,1,dir,flags);
+	if(desc == NULL)
+		return NULL;
+
+	desc->segs[0].addr = buf_addr;
+	desc->segs[0].len = buf_len;
+	desc->len = buf_len;
+	desc->cyclic = 1;
+	desc->period_len = period_len;
+
+	return &desc->tx;
+}
+
+static struct dma_async_tx_descriptor * _dma_sw_prep_dma_memcpy( \
+	struct dma_chan * chan, dma_addr_t dst, dma_addr_t src, \
+	size_t len, unsigned long flags)
+{
+	struct dma_sw_desc * desc;
+
+	if(len == 0)
+		return NULL;
+
+	desc = _dma_sw_desc_alloc(chan,1,DMA_MEM_TO_MEM,flags);
+	if(desc == NULL)
+		return NULL;
+
+	desc->segs[0].addr = src;
+	desc->segs[0].len = len;
+	desc->dst = dst;
+	desc->len = len;
+
+	return &desc->tx;
+}
+
+static void _dma_sw_issue_pending(struct dma_chan * chan)
+{
+	struct dma_sw_chan * sc = _dma_sw_chan(chan);
+	unsigned long flags;
+
+	spin_lock_irqsave(&sc->lock,flags);
+	if(!list_empty(&sc->list_submitted)) {
+		list_splice_tail_init(&sc->list_submitted,&sc->list_issued);
+		queue_work(dma_sw->wq,&sc->work);
+	}
+	spin_unlock_irqrestore(&sc->lock,flags);
+}
+
+static enum dma_status _dma_sw_tx_status(struct dma_chan * chan, \
+	dma_cookie_t cookie, struct dma_tx_state * state)
+{
+	struct dma_sw_chan * sc = _dma_sw_chan(chan);
+	struct dma_sw_desc * desc;
+	enum dma_status status;
+	unsigned long flags;
+	u32 residue = 0;
+
+	spin_lock_irqsave(&sc->lock,flags);
+
+	status = dma_async_is_complete(cookie,chan->completed_cookie, \
+		chan->cookie);
+
+	if(status == DMA_COMPLETE) {
+		if(cookie == sc->error_cookie) {
+			status = DMA_ERROR;
+			residue = sc->error_residue;
+		}
+	} else if(sc->active != NULL && sc->active->tx.cookie == cookie) {
+		desc = sc->active;
+		residue = desc->failed ? desc->residue : desc->len-desc->pos;
+	} else {
+		list_for_each_entry(desc,&sc->list_issued,node)
+			if(desc->tx.cookie == cookie)
+				residue = desc->len;
+		list_for_each_entry(desc,&sc->list_submitted,node)
+			if(desc->tx.cookie == cookie)
+				residue = desc->len;
+	}
+
+	dma_set_tx_state(state,chan->completed_cookie,chan->cookie,residue);
+
+	spin_unlock_irqrestore(&sc->lock,flags);
+
+	return status;
+}
+
+static int _dma_sw_config(struct dma_chan * chan, \
+	struct dma_slave_config * config)
+{
+	struct dma_sw_chan * sc = _dma_sw_chan(chan);
+	unsigned long flags;
+
+	spin_lock_irqsave(&sc->lock,flags);
+	sc->config = *config;
+	spin_unlock_irqrestore(&sc->lock,flags);
+
+	return 0;
+}
+
+static int _dma_sw_terminate_all(struct dma_chan * chan)
+{
+	struct dma_sw_chan * sc = _dma_sw_chan(chan);
+	struct dma_sw_desc * desc;
+	struct dma_sw_desc * aux;
+	unsigned long flags;
+	LIST_HEAD(list_free);
+
+	spin_lock_irqsave(&sc->lock,flags);
+
+	list_splice_tail_init(&sc->list_prepared,&list_free);
+	list_splice_tail_init(&sc->list_submitted,&list_free);
+	list_splice_tail_init(&sc->list_issued,&list_free);
+
+	/* The work releases the descriptor in progress */
+	if(sc->active != NULL) {
+		sc->active->aborted = 1;
+		sc->active = NULL;
+	}
+
+	spin_unlock_irqrestore(&sc->lock,flags);
+
+	list_for_each_entry_safe(desc,aux,&list_free,node) {
+		list_del(&desc->node);
+		kfree(desc);
+	}
+
+	return 0;
+}
+
+static void _dma_sw_synchronize(struct dma_chan * chan)
+{
+	flush_work(&_dma_sw_chan(chan)->work);
+}
+
+static void _dma_sw_free_chan_resources(struct dma_chan * chan)
+{
+	_dma_sw_terminate_all(chan);
+	_dma_sw_synchronize(chan);
+}
+
+bool dma_sw_engine_filter(struct dma_chan * chan, void * param)
+{
+	return dma_sw != NULL && chan->device == &dma_sw->dma_dev;
+}
+EXPORT_SYMBOL_GPL(dma_sw_engine_filter);
+
+static int __init dma_sw_engine_init(void)
+{
+	struct dma_device * dd;
+	struct dma_sw_chan * sc;
+	unsigned int i;
+	int r;
+
+	if(nr_chans == 0)
+		return -EINVAL;
+
+	dma_sw = kzalloc(sizeof(*dma_sw),GFP_KERNEL);
+	if(dma_sw == NULL)
+		return -ENOMEM;
+
+	dma_sw->chans = kcalloc(nr_chans,sizeof(*dma_sw->chans),GFP_KERNEL);
+	if(dma_sw->chans == NULL) {
+		r = -ENOMEM;
+		goto err_chans;
+	}
+
+	dma_sw->wq = alloc_workqueue("dma_sw_engine", \
+		WQ_HIGHPRI | WQ_UNBOUND,0);
+	if(dma_sw->wq == NULL) {
+		r = -ENOMEM;
+		goto err_wq;
+	}
+
+	dma_sw->pdev = platform_device_register_simple(DMA_SW_ENGINE_NAME, \
+		PLATFORM_DEVID_NONE,NULL,0);
+	if(IS_ERR(dma_sw->pdev)) {
+		r = PTR_ERR(dma_sw->pdev);
+		goto err_pdev;
+	}
+
+	dma_coerce_mask_and_coherent(&dma_sw->pdev->dev,DMA_BIT_MASK(64));
+	dma_set_max_seg_size(&dma_sw->pdev->dev,max_seg);
+
+	dd = &dma_sw->dma_dev;
+	dd->dev = &dma_sw->pdev->dev;
+	dma_cap_set(DMA_SLAVE,dd->cap_mask);
+	dma_cap_set(DMA_CYCLIC,dd->cap_mask);
+	dma_cap_set(DMA_MEMCPY,dd->cap_mask);
+
+	dd->device_prep_slave_sg = _dma_sw_prep_slave_sg;
+	dd->device_prep_dma_cyclic = _dma_sw_prep_dma_cyclic;
+	dd->device_prep_dma_memcpy = _dma_sw_prep_dma_memcpy;
+	dd->device_issue_pending = _dma_sw_issue_pending;
+	dd->device_tx_status = _dma_sw_tx_status;
+	dd->device_config = _dma_sw_config;
+	dd->device_terminate_all = _dma_sw_terminate_all;
+	dd->device_synchronize = _dma_sw_synchronize;
+	dd->device_free_chan_resources = _dma_sw_free_chan_resources;
+
+	dd->src_addr_widths = BIT(DMA_SLAVE_BUSWIDTH_1_BYTE) | \
+		BIT(DMA_SLAVE_BUSWIDTH_2_BYTES) | \
+		BIT(DMA_SLAVE_BUSWIDTH_4_BYTES) | \
+		BIT(DMA_SLAVE_BUSWIDTH_8_BYTES);
+	dd->dst_addr_widths = dd->src_addr_widths;
+	dd->directions = BIT(DMA_MEM_TO_DEV) | BIT(DMA_DEV_TO_MEM) | \
+		BIT(DMA_MEM_TO_MEM);
+	dd->residue_granularity = DMA_RESIDUE_GRANULARITY_BURST;
+	dd->copy_align = DMAENGINE_ALIGN_1_BYTE;
+
+	INIT_LIST_HEAD(&dd->channels);
+	for(i = 0; i < nr_chans; i++) {
+		sc = &dma_sw->chans[i];
+
+		sc->chan.device = dd;
+		INIT_LIST_HEAD(&sc->list_prepared);
+		INIT_LIST_HEAD(&sc->list_submitted);
+		INIT_LIST_HEAD(&sc->list_issued);
+		INIT_WORK(&sc->work,_dma_sw_work);
+		spin_lock_init(&sc->lock);
+
+		list_add_tail(&sc->chan.device_node,&dd->channels);
+	}
+
+	r = dma_async_device_register(dd);
+	if(r != 0) {
+		dev_err(dd->dev,"Cannot register the DMA device \n");
+		goto err_register;
+	}
+
+	return 0;
+
+err_register:
+	platform_device_unregister(dma_sw->pdev);
+err_pdev:
+	destroy_workqueue(dma_sw->wq);
+err_wq:
+	kfree(dma_sw->chans);
+err_chans:
+	kfree(dma_sw);
+	dma_sw = NULL;
+
+	return r;
+}
+
+static void __exit dma_sw_engine_exit(void)
+{
+	dma_async_device_unregister(&dma_sw->dma_dev);
+	platform_device_unregister(dma_sw->pdev);
+	destroy_workqueue(dma_sw->wq);
+	kfree(dma_sw->chans);
+	kfree(dma_sw);
+	dma_sw = NULL;
+}
+
+module_init(dma_sw_engine_init);
+module_exit(dma_sw_engine_exit);
+
+MODULE_AUTHOR("Miguel Jimenez Lopez <klyone@ugr.es>");
+MODULE_DESCRIPTION("Software DMA engine");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * Software DMA engine (header).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef DMA_SW_ENGINE_H
+#define DMA_SW_ENGINE_H
+
+#include <linux/types.h>
+#include <linux/dmaengine.h>
+
+#define DMA_SW_ENGINE_NAME "dma-sw-engine"
+
+/**
+ *
+ * dma_sw_engine_filter - DMA channel filter for dma_request_channel.
+ * It selects the channels of the software DMA engine.
+ *
+ * @chan: DMA channel.
+ * @param: Not used.
+ *
+ * Return: true if the channel belongs to the software DMA engine.
+ *
+ */
+bool dma_sw_engine_filter(struct dma_chan * chan, void * param);
+
+#endif /* DMA_SW_ENGINE_H */
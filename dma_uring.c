@@ -0,0 +1,724 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA submission/completion rings functions (implementation).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include <linux/slab.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/poll.h>
+#include <linux/uaccess.h>
+#include <linux/log2.h>
+#include <linux/dma-mapping.h>
+
+#include "dma_uring.h"
+#include "user_dma_block.h"
+
+static void _dma_uring_dev_release(struct kref * kref)
+{
+	kfree(container_of(kref,struct dma_uring_dev,kref));
+}
+
+static void _dma_uring_dev_put(struct dma_uring_dev * udev)
+{
+	kref_put(&udev->kref,_dma_uring_dev_release);
+}
+
+/* The DMA channel may be gone: only the rings are left */
+static int _dma_uring_dead(struct dma_uring * ur)
+{
+	return READ_ONCE(ur->udev->dead);
+}
+
+static struct device * _dma_uring_dev(struct dma_uring * ur)
+{
+	return ur->udev->dma_chan->device->dev;
+}
+
+/* Number of completion entries that are not reaped yet */
+static u32 _dma_uring_cq_ready(struct dma_uring * ur)
+{
+	return smp_load_acquire(&ur->cq->tail)-READ_ONCE(ur->cq->head);
+}
+
+static void _dma_uring_post(struct dma_uring * ur, u64 user_data, s32 res)
+{
+	struct dma_uring_cqe * cqe;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ur->cq_lock,flags);
+	cqe = &ur->cqes[ur->cq_tail & ur->cq->mask];
+	cqe->user_data = user_data;
+	cqe->res = res;
+	cqe->flags = 0;
+	ur->cq_tail++;
+	smp_store_release(&ur->cq->tail,ur->cq_tail);
+	spin_unlock_irqrestore(&ur->cq_lock,flags);
+
+	wake_up_interruptible(&ur->wait);
+}
+
+static void _dma_uring_req_free(struct dma_uring_req * req)
+{
+	struct dma_xfer * xfer;
+	struct dma_xfer * aux;
+
+	list_for_each_entry_safe(xfer,aux,&req->op->list_dma_xfer,node) {
+		dma_op_del_xfer(req->op,xfer);
+		dma_xfer_free(xfer);
+	}
+
+	dma_op_free(req->op);
+	kfree(req);
+}
+
+/*
+ * Sync the scatterlist entries of a buffer that cover a range, with the
+ * direction of the mapping. Only the covered entries are synced: other
+ * requests may be using the rest of the buffer.
+ */
+static void _dma_uring_sync(struct device * dev, struct dma_uring_rbuf * buf, \
+	u64 off, u32 len, int for_cpu)
+{
+	struct scatterlist * sg;
+	u64 start = 0;
+	int i;
+
+	for_each_sgtable_sg(&buf->sgt,sg,i) {
+		if(start >= off+len)
+			break;
+
+		if(start+sg->length > off) {
+			if(for_cpu)
+				dma_sync_sg_for_cpu(dev,sg,1,buf->dir);
+			else
+				dma_sync_sg_for_device(dev,sg,1,buf->dir);
+		}
+
+		start += sg->length;
+	}
+}
+
+static void _dma_uring_callback(void * param)
+{
+	struct dma_uring_req * req = param;
+	struct dma_uring * ur = req->ur;
+	unsigned long flags;
+
+	/* Give the written data back to the CPU */
+	_dma_uring_sync(_dma_uring_dev(ur),req->dst,req->dst_off,req->len,1);
+
+	_dma_uring_post(ur,req->user_data,req->res);
+	_dma_uring_req_free(req);
+
+	/* The release may free the DMA Uring as soon as inflight is 0 */
+	spin_lock_irqsave(&ur->wait.lock,flags);
+	if(atomic_dec_and_test(&ur->inflight))
+		wake_up_locked(&ur->wait);
+	spin_unlock_irqrestore(&ur->wait.lock,flags);
+}
+
+/* Get the DMA address of a buffer offset and the contiguous length */
+static int _dma_uring_resolve(struct dma_uring_rbuf * buf, u64 off, \
+	dma_addr_t * dma, size_t * len)
+{
+	struct scatterlist * sg;
+	int i;
+
+	for_each_sgtable_dma_sg(&buf->sgt,sg,i) {
+		if(off < sg_dma_len(sg)) {
+			*dma = sg_dma_address(sg)+off;
+			*len = sg_dma_len(sg)-off;
+			return 0;
+		}
+
+		off -= sg_dma_len(sg);
+	}
+
+	return -1;
+}
+
+static struct dma_uring_rbuf * _dma_uring_get_buf(struct dma_uring * ur, \
+	unsigned int index, u64 off, u32 len)
+{
+	struct dma_uring_rbuf * buf;
+
+	if(index >= DMA_URING_MAX_BUFS)
+		return NULL;
+
+	buf = &ur->bufs[index];
+	if(buf->block == NULL || off > buf->len || len > buf->len-off)
+		return NULL;
+
+	return buf;
+}
+
+/* Prepare one DMA Xfer per chunk that is contiguous in both buffers */
+static int _dma_uring_prep_copy(struct dma_uring * ur, \
+	struct dma_uring_req * req, struct dma_uring_sqe * sqe)
+{
+	struct dma_uring_dev * udev = ur->udev;
+	struct device * dev = _dma_uring_dev(ur);
+	struct dma_uring_rbuf * src;
+	struct dma_uring_rbuf * dst;
+	struct dma_memcpy_info info;
+	struct dma_xfer * xfer = NULL;
+	u64 src_off = sqe->src_off;
+	u64 dst_off = sqe->dst_off;
+	size_t left = sqe->len;
+	size_t src_len;
+	size_t dst_len;
+
+	src = _dma_uring_get_buf(ur,sqe->src_index,sqe->src_off,sqe->len);
+	dst = _dma_uring_get_buf(ur,sqe->dst_index,sqe->dst_off,sqe->len);
+	if(src == NULL || dst == NULL || dst->rdonly || sqe->len == 0)
+		return -EINVAL;
+
+	req->dst = dst;
+	req->dst_off = sqe->dst_off;
+	req->len = sqe->len;
+
+	_dma_uring_sync(dev,src,sqe->src_off,sqe->len,0);
+	_dma_uring_sync(dev,dst,sqe->dst_off,sqe->len,0);
+
+	while(left > 0) {
+		if(_dma_uring_resolve(src,src_off,&info.src,&src_len) != 0 || \
+			_dma_uring_resolve(dst,dst_off,&info.dst,&dst_len) != 0)
+			return -EINVAL;
+
+		xfer = dma_xfer_create(udev->dma_chan,&udev->dma_config, \
+			dev,GFP_KERNEL);
+		if(xfer == NULL)
+			return -ENOMEM;
+
+		info.len = min3(left,src_len,dst_len);
+		info.len = min_t(size_t,info.len,xfer->max_seg);
+
+		if(!is_dma_copy_aligned(udev->dma_chan->device, \
+			info.src,info.dst,info.len)) {
+			dma_xfer_free(xfer);
+			return -EINVAL;
+		}
+
+		dma_xfer_memcpy_setup(xfer,&info);
+		if(dma_xfer_prep_start_memcpy(xfer,NULL,NULL, \
+			DMA_PREP_INTERRUPT | DMA_CTRL_ACK) != 0) {
+			dma_xfer_free(xfer);
+			return -ENOMEM;
+		}
+
+		dma_op_add_xfer(req->op,xfer);
+
+		src_off += info.len;
+		dst_off += info.len;
+		left -= info.len;
+	}
+
+	req->res = sqe->len;
+
+	return 0;
+}
+
+static int _dma_uring_submit_sqe(struct dma_uring * ur, \
+	struct dma_uring_sqe * sqe)
+{
+	struct dma_uring_req * req;
+	struct dma_xfer * xfer;
+	int r;
+
+	if(sqe->opcode == DMA_URING_OP_NOP) {
+		_dma_uring_post(ur,sqe->user_data,0);
+		return 0;
+	}
+
+	if(sqe->opcode != DMA_URING_OP_COPY) {
+		_dma_uring_post(ur,sqe->user_data,-EINVAL);
+		return 0;
+	}
+
+	req = kzalloc(sizeof(*req),GFP_KERNEL);
+	if(req == NULL)
+		return -ENOMEM;
+
+	req->op = dma_op_create(GFP_KERNEL);
+	if(req->op == NULL) {
+		kfree(req);
+		return -ENOMEM;
+	}
+
+	req->ur = ur;
+	req->user_data = sqe->user_data;
+
+	r = _dma_uring_prep_copy(ur,req,sqe);
+
+	/*
+	 * The chunks that have been prepared must be submitted anyway
+	 * (there is no way to give them back to the channel), so a failed
+	 * request completes with the error after them.
+	 */
+	if(list_empty(&req->op->list_dma_xfer)) {
+		_dma_uring_req_free(req);
+		_dma_uring_post(ur,sqe->user_data,r);
+		return 0;
+	}
+
+	if(r != 0)
+		req->res = r;
+
+	/* The channel completes the chunks in order */
+	xfer = list_last_entry(&req->op->list_dma_xfer,struct dma_xfer,node);
+	dma_xfer_set_callback(xfer,_dma_uring_callback,req);
+
+	atomic_inc(&ur->inflight);
+
+	list_for_each_entry(xfer,&req->op->list_dma_xfer,node)
+		dma_xfer_submit(xfer);
+
+	return 0;
+}
+
+static int _dma_uring_enter(struct dma_uring * ur, \
+	struct dma_uring_enter * enter)
+{
+	struct dma_uring_sqe sqe;
+	u32 cq_used;
+	u32 tail;
+	int r = 0;
+
+	enter->submitted = 0;
+
+	mutex_lock(&ur->lock);
+
+	if(_dma_uring_dead(ur)) {
+		mutex_unlock(&ur->lock);
+		return -ENODEV;
+	}
+
+	if(ur->sq == NULL) {
+		mutex_unlock(&ur->lock);
+		return -EINVAL;
+	}
+
+	tail = smp_load_acquire(&ur->sq->tail);
+
+	while(enter->submitted < enter->to_submit && ur->sq_head != tail) {
+		/* Each request needs a free completion entry */
+		cq_used = READ_ONCE(ur->cq_tail)-READ_ONCE(ur->cq->head);
+		if(cq_used+atomic_read(&ur->inflight) >= ur->cq->entries)
+			break;
+
+		/* Private copy: user space may change the entry */
+		memcpy(&sqe,&ur->sqes[ur->sq_head & ur->sq->mask],sizeof(sqe));
+
+		r = _dma_uring_submit_sqe(ur,&sqe);
+		if(r != 0)
+			break;
+
+		ur->sq_head++;
+		enter->submitted++;
+	}
+
+	smp_store_release(&ur->sq->head,ur->sq_head);
+
+	/* Start the whole batch at once */
+	if(enter->submitted > 0)
+		dma_async_issue_pending(ur->udev->dma_chan);
+
+	mutex_unlock(&ur->lock);
+
+	if(enter->submitted == 0 && r != 0)
+		return r;
+
+	if(enter->min_complete > 0)
+		return wait_event_interruptible(ur->wait, \
+			_dma_uring_cq_ready(ur) >= enter->min_complete || \
+			_dma_uring_dead(ur));
+
+	return 0;
+}
+
+static void * _dma_uring_alloc_ring(unsigned int entries, size_t entry_size, \
+	size_t * size)
+{
+	struct dma_uring_ring * ring;
+
+	*size = PAGE_ALIGN(sizeof(*ring)+entries*entry_size);
+
+	ring = vmalloc_user(*size);
+	if(ring != NULL) {
+		ring->mask = entries-1;
+		ring->entries = entries;
+	}
+
+	return ring;
+}
+
+static int _dma_uring_setup(struct dma_uring * ur, \
+	struct dma_uring_params * p)
+{
+	if(p->sq_entries == 0 || p->sq_entries > DMA_URING_MAX_ENTRIES || \
+		p->cq_entries > DMA_URING_MAX_ENTRIES)
+		return -EINVAL;
+
+	p->sq_entries = roundup_pow_of_two(p->sq_entries);
+	if(p->cq_entries == 0)
+		p->cq_entries = min_t(u32,2*p->sq_entries,DMA_URING_MAX_ENTRIES);
+	p->cq_entries = roundup_pow_of_two(p->cq_entries);
+
+	mutex_lock(&ur->lock);
+
+	if(ur->sq != NULL) {
+		mutex_unlock(&ur->lock);
+		return -EBUSY;
+	}
+
+	ur->sq = _dma_uring_alloc_ring(p->sq_entries, \
+		sizeof(struct dma_uring_sqe),&ur->sq_size);
+	ur->cq = _dma_uring_alloc_ring(p->cq_entries, \
+		sizeof(struct dma_uring_cqe),&ur->cq_size);
+	if(ur->sq == NULL || ur->cq == NULL) {
+		vfree(ur->sq);
+		vfree(ur->cq);
+		ur->sq = NULL;
+		ur->cq = NULL;
+		mutex_unlock(&ur->lock);
+		return -ENOMEM;
+	}
+
+	ur->sqes = (struct dma_uring_sqe *) (ur->sq+1);
+	ur->cqes = (struct dma_uring_cqe *) (ur->cq+1);
+
+	mutex_unlock(&ur->lock);
+
+	p->sq_size = ur->sq_size;
+	p->cq_size = ur->cq_size;
+
+	return 0;
+}
+
+static void _dma_uring_release_buf(struct dma_uring * ur, \
+	struct dma_uring_rbuf * buf)
+{
+	dma_unmap_sgtable(_dma_uring_dev(ur),&buf->sgt,buf->dir,0);
+	sg_free_table(&buf->sgt);
+	user_dma_block_free(buf->block);
+	buf->block = NULL;
+}
+
+static int _dma_uring_register(struct dma_uring * ur, \
+	struct dma_uring_buf * ubuf)
+{
+	struct dma_uring_rbuf * buf = NULL;
+	struct page ** pages;
+	unsigned int npages;
+	unsigned int offset;
+	int rdonly = (ubuf->flags & DMA_URING_BUF_RDONLY) != 0;
+	int r;
+	int i;
+
+	if(ubuf->len == 0 || ubuf->len > UINT_MAX)
+		return -EINVAL;
+
+	mutex_lock(&ur->lock);
+
+	if(_dma_uring_dead(ur)) {
+		r = -ENODEV;
+		goto out;
+	}
+
+	for(i = 0; i < DMA_URING_MAX_BUFS; i++) {
+		if(ur->bufs[i].block == NULL) {
+			buf = &ur->bufs[i];
+			break;
+		}
+	}
+
+	if(buf == NULL) {
+		r = -ENOSPC;
+		goto out;
+	}
+
+	buf->block = user_dma_block_create(ubuf->addr,ubuf->len,!rdonly, \
+		GFP_KERNEL);
+	if(buf->block == NULL) {
+		r = -EFAULT;
+		goto out;
+	}
+
+	pages = dma_block_get_pages(buf->block,&npages,&offset);
+
+	r = sg_alloc_table_from_pages(&buf->sgt,pages,npages,offset, \
+		ubuf->len,GFP_KERNEL);
+	if(r != 0)
+		goto err_sgt;
+
+	buf->dir = rdonly ? DMA_TO_DEVICE : DMA_BIDIRECTIONAL;
+	r = dma_map_sgtable(_dma_uring_dev(ur),&buf->sgt,buf->dir,0);
+	if(r != 0)
+		goto err_map;
+
+	buf->len = ubuf->len;
+	buf->rdonly = rdonly;
+	ubuf->index = i;
+
+	goto out;
+
+err_map:
+	sg_free_table(&buf->sgt);
+err_sgt:
+	user_dma_block_free(buf->block);
+	buf->block = NULL;
+out:
+	mutex_unlock(&ur->lock);
+
+	return r;
+}
+
+static int _dma_uring_unregister(struct dma_uring * ur, u32 index)
+{
+	int r = 0;
+
+	if(index >= DMA_URING_MAX_BUFS)
+		return -EINVAL;
+
+	mutex_lock(&ur->lock);
+
+	if(ur->bufs[index].block == NULL)
+		r = -EINVAL;
+	else if(atomic_read(&ur->inflight) > 0)
+		r = -EBUSY;
+	else
+		_dma_uring_release_buf(ur,&ur->bufs[index]);
+
+	mutex_unlock(&ur->lock);
+
+	return r;
+}
+
+static long _dma_uring_ioctl(struct file * file, unsigned int cmd, \
+	unsigned long arg)
+{
+	struct dma_uring * ur = file->private_data;
+	void __user * uarg = (void __user *) arg;
+	struct dma_uring_params params;
+	struct dma_uring_buf ubuf;
+	struct dma_uring_enter enter;
+	u32 index;
+	int r;
+
+	switch(cmd) {
+	case DMA_URING_IOC_SETUP:
+		if(copy_from_user(&params,uarg,sizeof(params)))
+			return -EFAULT;
+		r = _dma_uring_setup(ur,&params);
+		if(r == 0 && copy_to_user(uarg,&params,sizeof(params)))
+			r = -EFAULT;
+		return r;
+
+	case DMA_URING_IOC_REGISTER:
+		if(copy_from_user(&ubuf,uarg,sizeof(ubuf)))
+			return -EFAULT;
+		r = _dma_uring_register(ur,&ubuf);
+		if(r == 0 && copy_to_user(uarg,&ubuf,sizeof(ubuf))) {
+			_dma_uring_unregister(ur,ubuf.index);
+			r = -EFAULT;
+		}
+		return r;
+
+	case DMA_URING_IOC_UNREGISTER:
+		if(get_user(index,(u32 __user *) uarg))
+			return -EFAULT;
+		return _dma_uring_unregister(ur,index);
+
+	case DMA_URING_IOC_ENTER:
+		if(copy_from_user(&enter,uarg,sizeof(enter)))
+			return -EFAULT;
+		r = _dma_uring_enter(ur,&enter);
+		if(copy_to_user(uarg,&enter,sizeof(enter)))
+			r = -EFAULT;
+		return r;
+
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int _dma_uring_mmap(struct file * file, struct vm_area_struct * vma)
+{
+	struct dma_uring * ur = file->private_data;
+	unsigned long size = vma->vm_end-vma->vm_start;
+	void * ring;
+	size_t ring_size;
+
+	switch(vma->vm_pgoff << PAGE_SHIFT) {
+	case DMA_URING_OFF_SQ:
+		ring = ur->sq;
+		ring_size = ur->sq_size;
+		break;
+	case DMA_URING_OFF_CQ:
+		ring = ur->cq;
+		ring_size = ur->cq_size;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if(ring == NULL || size > ring_size)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma,ring,0);
+}
+
+static __poll_t _dma_uring_poll(struct file * file, \
+	struct poll_table_struct * wait)
+{
+	struct dma_uring * ur = file->private_data;
+
+	__poll_t mask = 0;
+
+	poll_wait(file,&ur->wait,wait);
+
+	if(ur->cq != NULL && _dma_uring_cq_ready(ur) > 0)
+		mask |= EPOLLIN | EPOLLRDNORM;
+
+	if(_dma_uring_dead(ur))
+		mask |= EPOLLHUP;
+
+	return mask;
+}
+
+static int _dma_uring_open(struct inode * inode, struct file * file)
+{
+	struct dma_uring_dev * udev = container_of(file->private_data, \
+		struct dma_uring_dev,misc);
+	struct dma_uring * ur;
+
+	ur = kzalloc(sizeof(*ur),GFP_KERNEL);
+	if(ur == NULL)
+		return -ENOMEM;
+
+	/* misc_deregister waits for the open calls in progress */
+	kref_get(&udev->kref);
+
+	ur->udev = udev;
+	mutex_init(&ur->lock);
+	spin_lock_init(&ur->cq_lock);
+	init_waitqueue_head(&ur->wait);
+	atomic_set(&ur->inflight,0);
+
+	file->private_data = ur;
+
+	mutex_lock(&udev->lock);
+	list_add_tail(&ur->node,&udev->list_ur);
+	mutex_unlock(&udev->lock);
+
+	return 0;
+}
+
+/* Wait for the requests in flight and release the buffers */
+static void _dma_uring_quiesce(struct dma_uring * ur)
+{
+	int i;
+
+	/* The buffers are in use until the last request completes */
+	wait_event(ur->wait,atomic_read(&ur->inflight) == 0);
+	spin_lock_irq(&ur->wait.lock);
+	spin_unlock_irq(&ur->wait.lock);
+
+	for(i = 0; i < DMA_URING_MAX_BUFS; i++)
+		if(ur->bufs[i].block != NULL)
+			_dma_uring_release_buf(ur,&ur->bufs[i]);
+}
+
+static int _dma_uring_release(struct inode * inode, struct file * file)
+{
+	struct dma_uring * ur = file->private_data;
+	struct dma_uring_dev * udev = ur->udev;
+
+	/* The unregistration must not return while the channel is in use */
+	mutex_lock(&udev->lock);
+	list_del(&ur->node);
+	_dma_uring_quiesce(ur);
+	mutex_unlock(&udev->lock);
+
+	vfree(ur->sq);
+	vfree(ur->cq);
+	_dma_uring_dev_put(ur->udev);
+	kfree(ur);
+
+	return 0;
+}
+
+static const struct file_operations dma_uring_fops = {
+	.owner = THIS_MODULE,
+	.open = _dma_uring_open,
+	.release = _dma_uring_release,
+	.unlocked_ioctl = _dma_uring_ioctl,
+	.mmap = _dma_uring_mmap,
+	.poll = _dma_uring_poll,
+	.llseek = noop_llseek,
+};
+
+struct dma_uring_dev * dma_uring_dev_register(struct dma_chan * dma_chan, \
+	struct dma_slave_config * dma_config, const char * name, gfp_t gfp)
+{
+	struct dma_uring_dev * udev;
+
+	if(!dma_has_cap(DMA_MEMCPY,dma_chan->device->cap_mask))
+		return NULL;
+
+	udev = kzalloc(sizeof(*udev),gfp);
+	if(udev == NULL)
+		return NULL;
+
+	udev->dma_chan = dma_chan;
+	udev->dma_config = *dma_config;
+	kref_init(&udev->kref);
+	mutex_init(&udev->lock);
+	INIT_LIST_HEAD(&udev->list_ur);
+
+	strscpy(udev->name,name,sizeof(udev->name));
+	udev->misc.minor = MISC_DYNAMIC_MINOR;
+	udev->misc.name = udev->name;
+	udev->misc.fops = &dma_uring_fops;
+	udev->misc.parent = dma_chan->device->dev;
+
+	if(misc_register(&udev->misc) != 0) {
+		dev_err(dma_chan->device->dev, \
+			"Cannot register the DMA Uring device \n");
+		kfree(udev);
+		return NULL;
+	}
+
+	return udev;
+}
+
+void dma_uring_dev_unregister(struct dma_uring_dev * udev)
+{
+	struct dma_uring * ur;
+
+	if(udev != NULL) {
+		misc_deregister(&udev->misc);
+
+		/* Revoke the open files: nothing uses the channel after this */
+		mutex_lock(&udev->lock);
+		WRITE_ONCE(udev->dead,1);
+		list_for_each_entry(ur,&udev->list_ur,node) {
+			/* The next submissions see the device dead */
+			mutex_lock(&ur->lock);
+			_dma_uring_quiesce(ur);
+			mutex_unlock(&ur->lock);
+
+			wake_up_interruptible(&ur->wait);
+		}
+		mutex_unlock(&udev->lock);
+
+		_dma_uring_dev_put(udev);
+	}
+}
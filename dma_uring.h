@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA submission/completion rings functions (header).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef DMA_URING_H
+#define DMA_URING_H
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/list.h>
+#include <linux/kref.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/scatterlist.h>
+#include <linux/miscdevice.h>
+#include <linux/dmaengine.h>
+
+#include "dma_op.h"
+#include "dma_block.h"
+#include "dma_uring_uapi.h"
+
+#define DMA_URING_NAME_LEN 32
+#define DMA_URING_MAX_ENTRIES 4096
+#define DMA_URING_MAX_BUFS 64
+
+/**
+ *
+ * DMA Uring device structure. It is a character device that gives
+ * access to a memcpy DMA channel through submission/completion rings.
+ *
+ */
+struct dma_uring_dev {
+	/* Misc device */
+	struct miscdevice misc;
+	char name[DMA_URING_NAME_LEN];
+
+	/* DMAengine stuff */
+	struct dma_chan * dma_chan;
+	struct dma_slave_config dma_config;
+
+	/* References: the device and the open files */
+	struct kref kref;
+
+	/* Open files, revoked when the device is unregistered */
+	struct mutex lock;
+	struct list_head list_ur;
+	int dead;
+};
+
+/**
+ *
+ * DMA Uring registered buffer. It is pinned and DMA mapped once, so
+ * the requests only have to look up the DMA addresses.
+ *
+ */
+struct dma_uring_rbuf {
+	/* User DMA block (NULL: free slot) */
+	struct dma_block * block;
+	size_t len;
+	int rdonly;
+
+	/* DMA mapping */
+	struct sg_table sgt;
+	enum dma_data_direction dir;
+};
+
+/**
+ *
+ * DMA Uring structure (one per open file).
+ *
+ */
+struct dma_uring {
+	struct dma_uring_dev * udev;
+	struct list_head node;
+
+	/* Serializes setup, registration and submission */
+	struct mutex lock;
+
+	/* Submission ring (shared with user space) */
+	struct dma_uring_ring * sq;
+	struct dma_uring_sqe * sqes;
+	size_t sq_size;
+	u32 sq_head;
+
+	/* Completion ring (shared with user space) */
+	struct dma_uring_ring * cq;
+	struct dma_uring_cqe * cqes;
+	size_t cq_size;
+	u32 cq_tail;
+	spinlock_t cq_lock;
+
+	/* Requests submitted to the channel */
+	atomic_t inflight;
+	wait_queue_head_t wait;
+
+	/* Registered buffers */
+	struct dma_uring_rbuf bufs[DMA_URING_MAX_BUFS];
+};
+
+/**
+ *
+ * DMA Uring request. It is the DMA Operation of a submission entry
+ * (one DMA Xfer per contiguous chunk of the buffers).
+ *
+ */
+struct dma_uring_req {
+	struct dma_uring * ur;
+	struct dma_op * op;
+	u64 user_data;
+	s32 res;
+
+	/* Destination range, given back to the CPU on completion */
+	struct dma_uring_rbuf * dst;
+	u64 dst_off;
+	u32 len;
+};
+
+/**
+ *
+ * dma_uring_dev_register - Register a DMA Uring character device
+ * for a DMA channel with memcpy capability.
+ *
+ * @dma_chan: DMA channel.
+ * @dma_config: DMA configuration settings.
+ * @name: Device name (/dev/<name>).
+ * @gfp: Specific flags to request memory.
+ *
+ * Return: A DMA Uring device or NULL on error.
+ *
+ */
+struct dma_uring_dev * dma_uring_dev_register(struct dma_chan * dma_chan, \
+	struct dma_slave_config * dma_config, const char * name, gfp_t gfp);
+
+/**
+ *
+ * dma_uring_dev_unregister - Unregister a DMA Uring character device.
+ * The open files are revoked: their requests in flight are waited for,
+ * their buffers are unmapped and the next calls fail with -ENODEV. The
+ * DMA channel can be released after this. The structure itself is
+ * released when the last file is closed.
+ *
+ * @udev: DMA Uring device pointer.
+ *
+ */
+void dma_uring_dev_unregister(struct dma_uring_dev * udev);
+
+#endif /* DMA_URING_H */
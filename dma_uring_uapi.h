@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA submission/completion rings interface (shared with user space).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef DMA_URING_UAPI_H
+#define DMA_URING_UAPI_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/* mmap offsets of the submission and completion rings */
+#define DMA_URING_OFF_SQ 0x00000000ULL
+#define DMA_URING_OFF_CQ 0x08000000ULL
+
+/* Request opcodes */
+#define DMA_URING_OP_NOP 0
+#define DMA_URING_OP_COPY 1
+
+/* Registered buffer flags */
+#define DMA_URING_BUF_RDONLY (1 << 0)
+
+/**
+ *
+ * DMA Ring header. It is at the beginning of both mmap'd rings and
+ * it is followed by the ring entries. The producer and consumer
+ * indexes are free running (entry = index & mask) and they are on
+ * different cache lines.
+ *
+ * Submission ring: user space writes the entries and then the tail
+ * (release); the kernel moves the head.
+ * Completion ring: the kernel writes the entries and then the tail
+ * (release); user space moves the head.
+ *
+ */
+struct dma_uring_ring {
+	__u32 head;
+	__u32 pad0[15];
+	__u32 tail;
+	__u32 pad1[15];
+	__u32 mask;
+	__u32 entries;
+	__u32 pad2[14];
+};
+
+/**
+ *
+ * Submission entry.
+ *
+ * DMA_URING_OP_COPY copies len bytes from the registered buffer
+ * src_index (at src_off) to the registered buffer dst_index
+ * (at dst_off).
+ *
+ */
+struct dma_uring_sqe {
+	__u8 opcode;
+	__u8 flags;
+	__u16 src_index;
+	__u16 dst_index;
+	__u16 pad;
+	__u32 len;
+	__u32 pad1;
+	__u64 src_off;
+	__u64 dst_off;
+
+	/* Returned as is in the completion entry */
+	__u64 user_data;
+};
+
+/**
+ *
+ * Completion entry. res is the number of bytes transferred or a
+ * negative errno.
+ *
+ */
+struct dma_uring_cqe {
+	__u64 user_data;
+	__s32 res;
+	__u32 flags;
+};
+
+/**
+ *
+ * Setup parameters. The number of entries is rounded up to a power
+ * of two and the sizes of the rings (for mmap) are returned.
+ *
+ */
+struct dma_uring_params {
+	/* In/out */
+	__u32 sq_entries;
+	__u32 cq_entries;
+
+	/* Out */
+	__u32 sq_size;
+	__u32 cq_size;
+};
+
+/**
+ *
+ * Registered buffer. The buffer is pinned and DMA mapped until it
+ * is unregistered (or the file is closed).
+ *
+ */
+struct dma_uring_buf {
+	__u64 addr;
+	__u64 len;
+	__u32 flags;
+
+	/* Out */
+	__u32 index;
+};
+
+/**
+ *
+ * Submit the new entries of the submission ring (up to to_submit)
+ * and wait until there are min_complete entries in the completion
+ * ring.
+ *
+ */
+struct dma_uring_enter {
+	__u32 to_submit;
+	__u32 min_complete;
+
+	/* Out */
+	__u32 submitted;
+	__u32 pad;
+};
+
+#define DMA_URING_IOC_MAGIC 'U'
+#define DMA_URING_IOC_SETUP _IOWR(DMA_URING_IOC_MAGIC,0,struct dma_uring_params)
+#define DMA_URING_IOC_REGISTER _IOWR(DMA_URING_IOC_MAGIC,1,struct dma_uring_buf)
+#define DMA_URING_IOC_UNREGISTER _IOW(DMA_URING_IOC_MAGIC,2,__u32)
+#define DMA_URING_IOC_ENTER _IOWR(DMA_URING_IOC_MAGIC,3,struct dma_uring_enter)
+
+#endif /* DMA_URING_UAPI_H */
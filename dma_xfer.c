@@ -11,10 +11,41 @@
 #include <linux/slab.h>
 #include <linux/mm.h>
 #include <linux/dma-mapping.h>
+#include <linux/ktime.h>
 
 #include <asm/page.h>
 
 #include "dma_xfer.h"
+#include "dma_sg_table.h"
+#include "dma_op.h"
+#include "dma_stats.h"
+
+#define CREATE_TRACE_POINTS
+#include "dma_opl_trace.h"
+
+static unsigned int _dma_xfer_max_seg(struct device * hwdev)
+{
+	size_t max_seg = dma_get_max_seg_size(hwdev);
+	
+	/* e.g. swiotlb can't bounce big segments */
+	max_seg = min(max_seg,dma_max_mapping_size(hwdev));
+	
+	if(max_seg >= PAGE_SIZE)
+		max_seg &= PAGE_MASK;
+	
+	return min_t(size_t,max_seg,UINT_MAX & PAGE_MASK);
+}
+
+static int _dma_xfer_residue_ok(struct dma_chan * dma_chan)
+{
+	struct dma_slave_caps caps;
+	
+	if(dma_get_slave_caps(dma_chan,&caps) < 0)
+		return 0;
+	
+	return caps.residue_granularity != \
+		DMA_RESIDUE_GRANULARITY_DESCRIPTOR;
+}
 
 struct dma_xfer * dma_xfer_create(struct dma_chan * dma_chan, \
 	struct dma_slave_config * dma_config, struct device * hwdev, \
@@ -27,6 +58,13 @@ struct dma_xfer * dma_xfer_create(struct dma_chan * dma_chan, \
 		xfer->dma_chan = dma_chan;
 		xfer->dma_config = *dma_config;
 		xfer->hwdev = hwdev;
+		xfer->max_seg = min(_dma_xfer_max_seg(hwdev), \
+			_dma_xfer_max_seg(dma_chan->device->dev));
+		xfer->seg_boundary = dma_get_seg_boundary(hwdev) & \
+			dma_get_seg_boundary(dma_chan->device->dev);
+		xfer->residue_ok = _dma_xfer_residue_ok(dma_chan);
+		xfer->stats = dma_stats_chan_find(dma_chan);
+		init_completion(&xfer->done);
 		
 		INIT_LIST_HEAD(&xfer->list_dma_sg);
 	}
@@ -76,87 +114,79 @@ int dma_xfer_clear_sg(struct dma_xfer * xfer)
 	return r;
 }
 
-static int _dma_xfer_create_sg_table(struct dma_xfer * xfer, gfp_t gfp)
+void dma_xfer_set_limits(struct dma_xfer * xfer, \
+	unsigned int max_sg, unsigned int max_seg)
 {
-	struct list_head * p;
-	struct dma_sg * dsg;
-	int npages = 0;
-	int r;
+	if(max_sg != 0)
+		xfer->max_sg = max_sg;
 	
-	list_for_each(p,&xfer->list_dma_sg) {
-		dsg = list_entry(p,struct dma_sg,node);
-		
-		r = dma_sg_get_pages(dsg);
-		if(r > 0) {
-			npages += r;
-		}
-		else {
-			dev_err(xfer->hwdev,"Couldn't get pages for DMA SG \n");
-			npages = -1;
-			break;
-		}
-	}
-	
-	if(npages > 0) {
-		r = sg_alloc_table(&xfer->sgt,npages,gfp);
-		if(r) {
-			dev_err(xfer->hwdev,"Couldn't allocate SG Table \n");
-			npages = -2;
-		}
-	}
-	
-	return npages;
+	if(max_seg != 0)
+		xfer->max_seg = min(xfer->max_seg,max_seg);
 }
 
-/* This function is inspired by zio_dma_setup_scatter (dma.c) of
- * the ZIO project (http://www.ohwr.org/projects/zio).
- */
-static int _dma_xfer_setup_sg_table(struct dma_xfer * xfer)
+static int _dma_xfer_stats_on(struct dma_xfer * xfer)
 {
-	struct scatterlist * sg;
-	struct list_head * p;
-	struct dma_sg * dsg;
-	int bytesleft = 0;
-	void * bufp = NULL;
-	int mapbytes;
-	int i;
-	struct dma_block * blk;
+	return xfer->stats != NULL || xfer->pool_stats != NULL;
+}
+
+static void _dma_xfer_stats_add(struct dma_xfer * xfer, \
+	enum dma_stats_counter counter, u64 val)
+{
+	dma_stats_add(xfer->stats,counter,val);
+	dma_stats_add(xfer->pool_stats,counter,val);
+}
+
+static void _dma_xfer_stats_lat(struct dma_xfer * xfer, \
+	enum dma_stats_hist hist, u64 since, u64 now)
+{
+	dma_stats_lat(xfer->stats,hist,now-since);
+	dma_stats_lat(xfer->pool_stats,hist,now-since);
+}
+
+static void _dma_xfer_stats_prep(struct dma_xfer * xfer)
+{
+	if(_dma_xfer_stats_on(xfer))
+		xfer->t_prep = ktime_get_ns();
+}
+
+/* The DMA callback may run before dmaengine_submit returns */
+static void _dma_xfer_stats_presubmit(struct dma_xfer * xfer)
+{
+	if(_dma_xfer_stats_on(xfer))
+		xfer->t_submit = ktime_get_ns();
+}
+
+static void _dma_xfer_stats_submit(struct dma_xfer * xfer)
+{
+	if(!_dma_xfer_stats_on(xfer))
+		return;
 	
-	if(xfer == NULL)
-		return -1;
-		
-	sg = xfer->sgt.sgl;
-	i = 0;
-		
-	list_for_each(p,&xfer->list_dma_sg) {
-		dsg = list_entry(p,struct dma_sg,node);
-		
-		blk = dsg->block;
-		
-		bufp = dma_block_get_buffer(blk)+dsg->offset;
-		bytesleft = dma_block_get_size(blk)-dsg->offset;
-		
-		while(bytesleft && i < (xfer->sgt.nents)) {
-			if(bytesleft < (PAGE_SIZE-offset_in_page(bufp)))
-				mapbytes = bytesleft;
-			else
-				mapbytes = PAGE_SIZE-offset_in_page(bufp);
-				
-			if(is_vmalloc_addr(bufp))
-				sg_set_page(sg,vmalloc_to_page(bufp), mapbytes, \
-					offset_in_page(bufp));
-			else
-				sg_set_buf(sg,bufp,mapbytes);
-				
-			bufp += mapbytes;
-			bytesleft -= mapbytes;
-			
-			sg = sg_next(sg);
-			i++;
-		}
-	}
+	_dma_xfer_stats_add(xfer,DMA_STATS_XFERS,1);
+	_dma_xfer_stats_add(xfer,DMA_STATS_BYTES,xfer->len);
+	if(!xfer->cyclic)
+		_dma_xfer_stats_add(xfer,DMA_STATS_INFLIGHT,1);
+	_dma_xfer_stats_lat(xfer,DMA_STATS_LAT_PREP,xfer->t_prep, \
+		xfer->t_submit);
+}
+
+/* Cyclic transfers never complete: their periods are not counted */
+static void _dma_xfer_stats_complete(struct dma_xfer * xfer, \
+	enum dmaengine_tx_result result)
+{
+	if(!_dma_xfer_stats_on(xfer) || xfer->cyclic)
+		return;
 	
-	return 0;
+	_dma_xfer_stats_add(xfer,DMA_STATS_COMPLETED,1);
+	_dma_xfer_stats_add(xfer,DMA_STATS_INFLIGHT,-1);
+	if(result != DMA_TRANS_NOERROR)
+		_dma_xfer_stats_add(xfer,DMA_STATS_ERRORS,1);
+	_dma_xfer_stats_lat(xfer,DMA_STATS_LAT_COMPLETE,xfer->t_submit, \
+		ktime_get_ns());
+}
+
+static void _dma_xfer_free_sg_table(struct dma_xfer * xfer)
+{
+	dma_sg_table_free(&xfer->sgt,DMA_XFER_INLINE_SG);
 }
 
 static int _dma_xfer_map_sg(struct dma_xfer * xfer)
@@ -180,12 +210,104 @@ static int _dma_xfer_init_sg_table(struct dma_xfer * xfer, \
 {
 	int r = 0;
 	
-	r = _dma_xfer_create_sg_table(xfer,gfp);
-	if(r > 0) {
-		r = _dma_xfer_setup_sg_table(xfer);
-	}
+	r = dma_sg_table_create(&xfer->sgt,&xfer->list_dma_sg,xfer->max_seg, \
+		xfer->seg_boundary,xfer->sgl_inline,DMA_XFER_INLINE_SG,gfp);
+	if(r == -1)
+		dev_err(xfer->hwdev,"Couldn't get pages for DMA SG \n");
+	else if(r == -2)
+		dev_err(xfer->hwdev,"Couldn't allocate SG Table \n");
+	else if(r == -3)
+		dev_err(xfer->hwdev,"Couldn't setup DMA SG \n");
+	
+	return (r > 0) ? 0 : r;
+}
+
+static int _dma_xfer_borrow_sg_table(struct dma_xfer * xfer)
+{
+	struct list_head * p;
+	struct dma_sg * dsg;
+	struct sg_table * sgt = NULL;
+	struct sg_table * dsgt;
+	int n = 0;
+	
+	list_for_each(p,&xfer->list_dma_sg) {
+		dsg = list_entry(p,struct dma_sg,node);
 		
-	return r;
+		dsgt = dma_block_get_dma_sg_table(dsg->block,xfer->hwdev,\
+			xfer->dma_map_dir);
+		if(dsgt != NULL) {
+			if(dsg->offset != 0 || dma_sg_get_len(dsg) != \
+				dma_block_get_size(dsg->block)) {
+				dev_err(xfer->hwdev,"Mapped DMA SG with range \n");
+				return -1;
+			}
+			sgt = dsgt;
+		}
+		
+		n++;
+	}
+	
+	if(sgt == NULL)
+		return 1;
+	
+	if(n != 1) {
+		dev_err(xfer->hwdev,"Mapped DMA SG must be alone \n");
+		return -1;
+	}
+	
+	xfer->sgt = *sgt;
+	xfer->sgt_borrowed = 1;
+	
+	return 0;
+}
+
+/* Number of bytes of the mapped SG entries [first,last) */
+static size_t _dma_xfer_sg_len(struct dma_xfer * xfer, \
+	unsigned int first, unsigned int last)
+{
+	struct scatterlist * sg;
+	size_t len = 0;
+	unsigned int i;
+	
+	for_each_sg(xfer->sgt.sgl,sg,last,i) {
+		if(i >= first)
+			len += sg_dma_len(sg);
+	}
+	
+	return len;
+}
+
+/*
+ * The SG table is split in several descriptors if it has
+ * more entries than the channel can take in one descriptor.
+ */
+static int _dma_xfer_alloc_descs(struct dma_xfer * xfer, gfp_t gfp)
+{
+	unsigned int ndescs = 1;
+	
+	/* The DMA Xfer may be mapped again */
+	kfree(xfer->dma_descs);
+	kfree(xfer->dma_cookies);
+	xfer->dma_descs = NULL;
+	xfer->dma_cookies = NULL;
+	xfer->dma_ndescs = 0;
+	
+	if(xfer->max_sg != 0)
+		ndescs = DIV_ROUND_UP(xfer->sgt.nents,xfer->max_sg);
+	
+	if(ndescs > 1) {
+		xfer->dma_descs = kcalloc(ndescs,sizeof(*xfer->dma_descs),gfp);
+		xfer->dma_cookies = kcalloc(ndescs,sizeof(*xfer->dma_cookies), \
+			gfp);
+		if(xfer->dma_descs == NULL || xfer->dma_cookies == NULL) {
+			dev_err(xfer->hwdev,"Couldn't allocate descriptors \n");
+			return -2;
+		}
+	}
+	
+	xfer->dma_ndescs = ndescs;
+	
+	return 0;
 }
 
 int dma_xfer_map_sg(struct dma_xfer * xfer, \
@@ -196,11 +318,25 @@ int dma_xfer_map_sg(struct dma_xfer * xfer, \
 	
 	xfer->dma_map_dir = dma_map_dir;
 	
-	r = _dma_xfer_init_sg_table(xfer,gfp);
-	if(r == 0) {
-		r = _dma_xfer_map_sg(xfer);
+	/* Already mapped blocks (e.g. dma-buf): nothing to build */
+	r = _dma_xfer_borrow_sg_table(xfer);
+	if(r > 0) {
+		r = _dma_xfer_init_sg_table(xfer,gfp);
+		if(r == 0) {
+			r = _dma_xfer_map_sg(xfer);
+		}
 	}
 	
+	if(r == 0)
+		r = _dma_xfer_alloc_descs(xfer,gfp);
+	
+	if(r == 0)
+		xfer->len = _dma_xfer_sg_len(xfer,0,xfer->sgt.nents);
+	else
+		_dma_xfer_stats_add(xfer,DMA_STATS_MAP_FAILURES,1);
+	
+	trace_dma_xfer_map_sg(xfer,r);
+	
 	return r;
 }
 
@@ -218,6 +354,107 @@ int dma_xfer_rx_map_sg(struct dma_xfer * xfer, \
 		gfp);
 }
 
+/*
+ * The DMA callback goes through the DMA Xfer: the completion and the
+ * result are recorded for dma_xfer_wait before the user callback.
+ */
+static void _dma_xfer_callback(void * param, \
+	const struct dmaengine_result * result)
+{
+	struct dma_xfer * xfer = param;
+	void (*dma_cb_f)(void * param) = xfer->dma_cb_f;
+	void * dma_cb_param = xfer->dma_cb_param;
+	struct dma_op * op = xfer->op;
+	
+	trace_dma_xfer_complete(xfer,result);
+	
+	if(result != NULL) {
+		xfer->dma_result = result->result;
+		xfer->dma_residue = result->residue;
+	}
+	
+	_dma_xfer_stats_complete(xfer,xfer->dma_result);
+	
+	/*
+	 * The waiter may free the DMA Xfer (and its DMA Operation) once it
+	 * is signalled: a tracked Xfer is signalled by its DMA Operation
+	 * after the accounting.
+	 */
+	if(op != NULL)
+		dma_op_xfer_done(op,xfer, \
+			result ? result->result : DMA_TRANS_NOERROR, \
+			result ? result->residue : 0);
+	else
+		complete_all(&xfer->done);
+	
+	if(dma_cb_f != NULL)
+		dma_cb_f(dma_cb_param);
+}
+
+/* The DMA callback of an early dma_xfer_wait still uses the DMA Xfer */
+static void _dma_xfer_sync_callback(struct dma_xfer * xfer)
+{
+	if(xfer->cb_pending) {
+		wait_for_completion(&xfer->done);
+		xfer->cb_pending = 0;
+	}
+}
+
+static void _dma_xfer_set_trampoline(struct dma_xfer * xfer, \
+	void (*dma_cb_f)(void * param), void * dma_cb_param)
+{
+	_dma_xfer_sync_callback(xfer);
+	
+	xfer->dma_cb_f = dma_cb_f;
+	xfer->dma_cb_param = dma_cb_param;
+	xfer->dma_result = DMA_TRANS_NOERROR;
+	xfer->dma_residue = 0;
+	reinit_completion(&xfer->done);
+	
+	xfer->dma_desc->callback_result = _dma_xfer_callback;
+	xfer->dma_desc->callback_param = xfer;
+}
+
+void dma_xfer_set_callback(struct dma_xfer * xfer, \
+	void (*dma_cb_f)(void * param), void * dma_cb_param)
+{
+	xfer->dma_cb_f = dma_cb_f;
+	xfer->dma_cb_param = dma_cb_param;
+}
+
+/*
+ * Give back the first n descriptors of a chain that could not be
+ * completed (prepared but not submitted). Only the reusable ones can
+ * be freed: the others are leaked, since terminating the channel would
+ * abort the transfers of its other users.
+ */
+static void _dma_xfer_release_descs(struct dma_xfer * xfer, unsigned int n)
+{
+	unsigned int i;
+	int leaked = 0;
+	
+	for(i = 0; i < n; i++) {
+		if(dmaengine_desc_test_reuse(xfer->dma_descs[i]))
+			dmaengine_desc_free(xfer->dma_descs[i]);
+		else
+			leaked++;
+		
+		xfer->dma_descs[i] = NULL;
+	}
+	
+	if(leaked > 0)
+		dev_err(xfer->hwdev,"Leaked %d unsubmitted descriptors \n",leaked);
+}
+
+/* The chain is complete: the descriptors are released on completion */
+static void _dma_xfer_clear_reuse(struct dma_xfer * xfer)
+{
+	unsigned int i;
+	
+	for(i = 0; i < xfer->dma_ndescs; i++)
+		dmaengine_desc_clear_reuse(xfer->dma_descs[i]);
+}
+
 int dma_xfer_prep_start_sg(struct dma_xfer * xfer, \
 	enum dma_transfer_direction dma_dir, \
 	void (*dma_cb_f)(void * param), \
@@ -225,24 +462,65 @@ int dma_xfer_prep_start_sg(struct dma_xfer * xfer, \
 	unsigned long flags,
 	void * context)
 {
-	int r = 0;
+	struct dma_async_tx_descriptor * desc = NULL;
+	struct scatterlist * sg = xfer->sgt.sgl;
+	unsigned int left = xfer->sgt.nents;
+	unsigned int n;
+	unsigned int i;
+	unsigned int k;
 	
 	xfer->dma_dir = dma_dir;
+	xfer->synced = 0;
+	xfer->cyclic = 0;
+	_dma_xfer_stats_prep(xfer);
+	
+	if(xfer->dma_ndescs == 0) {
+		trace_dma_xfer_prep_start_sg(xfer,-1);
+		return -1;
+	}
 	
 	dmaengine_slave_config(xfer->dma_chan, &(xfer->dma_config));
 
-	xfer->dma_desc = xfer->dma_chan->device->device_prep_slave_sg(\
-			xfer->dma_chan, xfer->sgt.sgl, xfer->sgt.nents, \
-			dma_dir,flags,context);
-
-	if(xfer->dma_desc == NULL) {
-		r = -1;
-	} else {
-		xfer->dma_desc->callback = dma_cb_f;
-		xfer->dma_desc->callback_param = dma_cb_param;
+	/*
+	 * Only the last descriptor of the chain raises the interrupt
+	 * and calls the callback. The descriptors are completed in
+	 * order, so it means that the whole transfer has completed.
+	 */
+	for(i = 0; i < xfer->dma_ndescs; i++) {
+		n = (i+1 < xfer->dma_ndescs) ? xfer->max_sg : left;
+		
+		desc = xfer->dma_chan->device->device_prep_slave_sg(\
+			xfer->dma_chan, sg, n, dma_dir, \
+			(i+1 < xfer->dma_ndescs) ? \
+				(flags & ~DMA_PREP_INTERRUPT) : flags, \
+			context);
+		if(desc == NULL) {
+			dev_err(xfer->hwdev,"Couldn't prepare descriptor %u \n",i);
+			_dma_xfer_release_descs(xfer,i);
+			_dma_xfer_stats_add(xfer,DMA_STATS_PREP_FAILURES,1);
+			trace_dma_xfer_prep_start_sg(xfer,-1);
+			return -1;
+		}
+		
+		/* A split chain can be given back if its end can't be prepared */
+		if(xfer->dma_descs != NULL) {
+			dmaengine_desc_set_reuse(desc);
+			xfer->dma_descs[i] = desc;
+		}
+		
+		for(k = 0; k < n; k++)
+			sg = sg_next(sg);
+		left -= n;
 	}
 
-	return r;
+	if(xfer->dma_descs != NULL)
+		_dma_xfer_clear_reuse(xfer);
+
+	xfer->dma_desc = desc;
+	_dma_xfer_set_trampoline(xfer,dma_cb_f,dma_cb_param);
+	trace_dma_xfer_prep_start_sg(xfer,0);
+
+	return 0;
 	
 }
 
@@ -281,6 +559,9 @@ int dma_xfer_prep_start_cyclic(struct dma_xfer *xfer, \
 	int r = 0;
 
 	xfer->dma_dir = dma_dir;
+	xfer->len = xfer->dcyc_info.len;
+	xfer->cyclic = 1;
+	_dma_xfer_stats_prep(xfer);
 
 	dmaengine_slave_config(xfer->dma_chan, &(xfer->dma_config));
 
@@ -291,12 +572,14 @@ int dma_xfer_prep_start_cyclic(struct dma_xfer *xfer, \
 			flags);
 
 	if(xfer->dma_desc == NULL) {
+		_dma_xfer_stats_add(xfer,DMA_STATS_PREP_FAILURES,1);
 		r = -1;
 	} else {
-		xfer->dma_desc->callback = dma_cb_f;
-		xfer->dma_desc->callback_param = dma_cb_param;
+		_dma_xfer_set_trampoline(xfer,dma_cb_f,dma_cb_param);
 	}
 
+	trace_dma_xfer_prep_start_cyclic(xfer,r);
+
 	return r;
 }
 
@@ -314,6 +597,9 @@ int dma_xfer_prep_start_memcpy(struct dma_xfer *xfer, \
 	int r = 0;
 
 	xfer->dma_dir = DMA_MEM_TO_MEM;
+	xfer->len = xfer->dmemcpy_info.len;
+	xfer->cyclic = 0;
+	_dma_xfer_stats_prep(xfer);
 
 	dmaengine_slave_config(xfer->dma_chan, &(xfer->dma_config));
 
@@ -324,20 +610,64 @@ int dma_xfer_prep_start_memcpy(struct dma_xfer *xfer, \
 			flags);
 
 	if(xfer->dma_desc == NULL) {
+		_dma_xfer_stats_add(xfer,DMA_STATS_PREP_FAILURES,1);
 		r = -1;
 	} else {
-		xfer->dma_desc->callback = dma_cb_f;
-		xfer->dma_desc->callback_param = dma_cb_param;
+		_dma_xfer_set_trampoline(xfer,dma_cb_f,dma_cb_param);
 	}
 
+	trace_dma_xfer_prep_start_memcpy(xfer,r);
+
 	return r;
 }
 
-int dma_xfer_start(struct dma_xfer * xfer)
+int dma_xfer_submit(struct dma_xfer * xfer)
 {
 	int r = 0;
+	unsigned int i;
+	
+	_dma_xfer_stats_presubmit(xfer);
+	
+	/* The first descriptors of a split SG transfer */
+	for(i = 0; i+1 < xfer->dma_ndescs; i++) {
+		xfer->dma_cookies[i] = dmaengine_submit(xfer->dma_descs[i]);
+		if(dma_submit_error(xfer->dma_cookies[i]))
+			break;
+	}
+	
+	/*
+	 * The rest of a chain that fails is not submitted: the last
+	 * descriptor would call the callback of a failed DMA Xfer.
+	 */
+	if(i+1 < xfer->dma_ndescs) {
+		dev_err(xfer->hwdev,"Couldn't submit descriptor %u \n",i);
+		xfer->dma_cookie = xfer->dma_cookies[i];
+	} else {
+		xfer->dma_cookie = dmaengine_submit(xfer->dma_desc);
+		if(xfer->dma_cookies != NULL)
+			xfer->dma_cookies[i] = xfer->dma_cookie;
+	}
+	
+	if(dma_submit_error(xfer->dma_cookie)) {
+		_dma_xfer_stats_add(xfer,DMA_STATS_SUBMIT_FAILURES,1);
+		r = -1;
+	} else {
+		_dma_xfer_stats_submit(xfer);
+	}
+	
+	trace_dma_xfer_submit(xfer,r);
+	
+	return r;
+}
+
+int dma_xfer_start(struct dma_xfer * xfer)
+{
+	int r;
 	
-	xfer->dma_cookie = dmaengine_submit(xfer->dma_desc);
+	r = dma_xfer_submit(xfer);
+	
+	/* The DMA Xfer may be completed and freed after issue_pending */
+	trace_dma_xfer_start(xfer,r);
 	dma_async_issue_pending(xfer->dma_chan);
 	
 	return r;
@@ -349,11 +679,164 @@ enum dma_status dma_xfer_status(struct dma_xfer * xfer)
 			xfer->dma_cookie, NULL, NULL);
 }
 
+void dma_xfer_set_polled(struct dma_xfer * xfer)
+{
+	/* Some drivers call the callback even without DMA_PREP_INTERRUPT */
+	xfer->dma_desc->callback_result = NULL;
+	xfer->dma_desc->callback_param = NULL;
+}
+
+int dma_xfer_poll(struct dma_xfer * xfer)
+{
+	struct dmaengine_result result;
+	struct dma_tx_state state;
+	enum dma_status status;
+	
+	state.residue = 0;
+	status = dmaengine_tx_status(xfer->dma_chan,xfer->dma_cookie,&state);
+	if(status == DMA_IN_PROGRESS || status == DMA_PAUSED)
+		return 0;
+	
+	result.result = (status == DMA_COMPLETE) ? \
+		DMA_TRANS_NOERROR : DMA_TRANS_ABORTED;
+	result.residue = state.residue;
+	
+	/* Same path as the DMA callback */
+	_dma_xfer_callback(xfer,&result);
+	
+	return 1;
+}
+
+int dma_xfer_wait(struct dma_xfer * xfer, u64 poll_ns, \
+	unsigned long timeout)
+{
+	ktime_t end = ktime_add_ns(ktime_get(),poll_ns);
+	enum dma_status status;
+	
+	/*
+	 * Short transfers: spin on the channel instead of sleeping. The
+	 * channel completes the cookie before it schedules the DMA
+	 * callback, so this doesn't wait for the tasklet of the driver.
+	 */
+	while(poll_ns > 0 && !completion_done(&xfer->done)) {
+		status = dma_xfer_status(xfer);
+		if(status == DMA_COMPLETE || status == DMA_ERROR) {
+			xfer->cb_pending = !completion_done(&xfer->done);
+			return (status == DMA_COMPLETE) ? 0 : -1;
+		}
+		
+		if(ktime_after(ktime_get(),end))
+			break;
+		
+		cpu_relax();
+	}
+	
+	if(wait_for_completion_timeout(&xfer->done,timeout) == 0)
+		return -2;
+	
+	return (xfer->dma_result == DMA_TRANS_NOERROR) ? 0 : -1;
+}
+
+/* Number of bytes of the descriptor i of the DMA Xfer */
+static size_t _dma_xfer_desc_len(struct dma_xfer * xfer, unsigned int i)
+{
+	unsigned int first;
+	
+	if(xfer->dma_ndescs <= 1)
+		return xfer->len;
+	
+	first = i*xfer->max_sg;
+	
+	return _dma_xfer_sg_len(xfer,first, \
+		min(first+xfer->max_sg,xfer->sgt.nents));
+}
+
+int dma_xfer_get_progress(struct dma_xfer * xfer, \
+	struct dma_xfer_progress * progress)
+{
+	struct dma_tx_state state;
+	enum dma_status status = DMA_COMPLETE;
+	unsigned int ndescs = max(xfer->dma_ndescs,1U);
+	dma_cookie_t cookie;
+	size_t desc_len;
+	size_t done = 0;
+	unsigned int i;
+	
+	if(xfer->dma_cookie <= 0)
+		return -1;
+	
+	/* The descriptors complete in order */
+	for(i = 0; i < ndescs; i++) {
+		cookie = (ndescs > 1) ? xfer->dma_cookies[i] : xfer->dma_cookie;
+		desc_len = _dma_xfer_desc_len(xfer,i);
+		
+		state.residue = desc_len;
+		status = dmaengine_tx_status(xfer->dma_chan,cookie,&state);
+		if(status == DMA_COMPLETE) {
+			done += desc_len;
+			continue;
+		}
+		
+		if(xfer->residue_ok && state.residue <= desc_len)
+			done += desc_len-state.residue;
+		break;
+	}
+	
+	progress->status = status;
+	progress->len = xfer->len;
+	progress->done = done;
+	progress->residue = xfer->len-done;
+	
+	return (status == DMA_ERROR) ? -1 : 0;
+}
+
+size_t dma_xfer_sync_prefix(struct dma_xfer * xfer)
+{
+	struct dma_xfer_progress progress;
+	struct scatterlist * sg;
+	size_t pos = 0;
+	int i;
+	
+	if(dma_xfer_get_progress(xfer,&progress) != 0 || \
+		progress.done <= xfer->synced)
+		return xfer->synced;
+	
+	/*
+	 * Only the data written by the device has to be synced. The CPU
+	 * entries (not the merged DMA segments) that overlap the new part
+	 * of the prefix are synced as a whole: an entry that is still
+	 * being written is synced again on the next call.
+	 */
+	if(!xfer->sgt_borrowed && xfer->dma_map_dir != DMA_TO_DEVICE) {
+		for_each_sgtable_sg(&xfer->sgt,sg,i) {
+			if(pos >= progress.done)
+				break;
+			
+			if(pos+sg->length > xfer->synced)
+				dma_sync_sg_for_cpu(xfer->hwdev,sg,1, \
+					xfer->dma_map_dir);
+			
+			pos += sg->length;
+		}
+	}
+	
+	xfer->synced = progress.done;
+	
+	return xfer->synced;
+}
+
 void dma_xfer_free(struct dma_xfer * xfer)
 {
 	if(xfer != NULL) {
-		_dma_xfer_unmap_sg(xfer);
-		sg_free_table(&xfer->sgt);
+		_dma_xfer_sync_callback(xfer);
+		trace_dma_xfer_free(xfer,0);
+		
+		if(!xfer->sgt_borrowed) {
+			_dma_xfer_unmap_sg(xfer);
+			_dma_xfer_free_sg_table(xfer);
+		}
+		kfree(xfer->dma_descs);
+		kfree(xfer->dma_cookies);
 		kfree(xfer);
 	}
 }
@@ -17,9 +17,20 @@
 #include <linux/dma-direction.h>
 #include <linux/device.h>
 #include <linux/list.h>
+#include <linux/completion.h>
+#include <linux/atomic.h>
 
 #include "dma_sg.h"
 
+struct dma_op;
+struct dma_stats;
+
+/*
+ * Number of SG entries stored inside the DMA Xfer. Transfers that
+ * need more entries chain page sized chunks to this first one.
+ */
+#define DMA_XFER_INLINE_SG 4
+
 /**
  *
  * DMA Cyclic mode info.
@@ -42,6 +53,25 @@ struct dma_memcpy_info {
 	size_t len;
 };
 
+/**
+ *
+ * DMA Xfer progress.
+ *
+ */
+struct dma_xfer_progress {
+	/* Status of the first descriptor that has not completed */
+	enum dma_status status;
+
+	/* Total number of bytes */
+	size_t len;
+
+	/* Bytes transferred (in the order of the DMA SG list) */
+	size_t done;
+
+	/* Bytes left */
+	size_t residue;
+};
+
 /**
  * 
  * DMA Transfer (xfer) structure. It represents a DMA transaction.
@@ -50,9 +80,27 @@ struct dma_memcpy_info {
 struct dma_xfer {
 	/* SG structures */
 	struct sg_table sgt;
+	struct scatterlist sgl_inline[DMA_XFER_INLINE_SG];
 	struct list_head list_dma_sg;
 	enum dma_data_direction dma_map_dir;
 	
+	/* SG table owned (and mapped) by the DMA block */
+	int sgt_borrowed;
+	
+	/* Maximum size of a SG entry and boundary it must not cross */
+	unsigned int max_seg;
+	unsigned long seg_boundary;
+	
+	/* Maximum number of SG entries per descriptor (0: no limit) */
+	unsigned int max_sg;
+	
+	/* The residue is finer than a descriptor */
+	int residue_ok;
+	
+	/* Transfer size and the prefix that has been synced for the CPU */
+	size_t len;
+	size_t synced;
+	
 	/* memcpy and cyclic stuff */
 	struct dma_cyclic_info dcyc_info;
 	struct dma_memcpy_info dmemcpy_info;
@@ -64,6 +112,36 @@ struct dma_xfer {
 	struct dma_async_tx_descriptor * dma_desc;
 	dma_cookie_t dma_cookie;
 	
+	/* Descriptor chain of a split SG transfer (dma_desc is the last) */
+	struct dma_async_tx_descriptor ** dma_descs;
+	dma_cookie_t * dma_cookies;
+	
+	/* Completion (set by the DMA callback of the last descriptor) */
+	void (*dma_cb_f)(void * param);
+	void * dma_cb_param;
+	enum dmaengine_tx_result dma_result;
+	u32 dma_residue;
+	struct completion done;
+	
+	/* dma_xfer_wait returned before the DMA callback */
+	int cb_pending;
+	
+	/* Tracked DMA Operation (NULL if nobody waits for it) */
+	struct dma_op * op;
+	
+	/* Dependencies inside the DMA Operation */
+	unsigned int dma_npreds;
+	atomic_t dma_preds_left;
+	int dma_pred_failed;
+	unsigned int dma_ndescs;
+	
+	/* Statistics of the channel and of the packet descriptor pool */
+	struct dma_stats * stats;
+	struct dma_stats * pool_stats;
+	u64 t_prep;
+	u64 t_submit;
+	int cyclic;
+	
 	/* Reference to internal Linux dev */
 	struct device * hwdev;
 	
@@ -122,12 +200,41 @@ int dma_xfer_del_sg(struct dma_xfer * xfer, struct dma_sg * sg);
  */
 int dma_xfer_clear_sg(struct dma_xfer * xfer);
 
+/**
+ *
+ * dma_xfer_set_limits - Set the limits of the DMA controller that
+ * are not reported by the DMAengine (e.g. the size of the descriptor
+ * ring). By default, the number of SG entries per descriptor is not
+ * limited (the DMAengine doesn't report it: max_sg_burst is a burst
+ * limit) and the size of a SG entry is limited by dma_get_max_seg_size
+ * of the devices. It must be called before mapping the DMA Xfer.
+ *
+ * If the SG table has more entries than max_sg, the transfer is split
+ * in a chain of descriptors that are submitted back-to-back. Only the
+ * last descriptor calls the callback. The chain is prepared as reusable
+ * (DMA_CTRL_REUSE) if the channel supports it, so the descriptors can
+ * be freed if one of them cannot be prepared. Otherwise they are leaked:
+ * the channel is left alone.
+ *
+ * @xfer: DMA Xfer pointer.
+ * @max_sg: Maximum number of SG entries per descriptor (0: unchanged).
+ * @max_seg: Maximum size of a SG entry (0: unchanged).
+ *
+ */
+void dma_xfer_set_limits(struct dma_xfer * xfer, \
+	unsigned int max_sg, unsigned int max_seg);
+
 /**
  * 
  * dma_xfer_map_sg - Map all the DMA SG structures related with
  * the DMA Xfer. This function also creates and initializes the
  * Scatter-Gather Table for the DMA transaction.
  * 
+ * If the DMA SG refers to a block that is already DMA mapped
+ * (e.g. a dma-buf), its SG table is used directly and no table
+ * is built. In that case, it must be the only DMA SG of the
+ * DMA Xfer and it must cover the whole block.
+ * 
  * @xfer: DMA Xfer pointer.
  * @dma_map_dir: DMA direction (@see <linux/dma-direction.h>)
  * 		DMA_BIDIRECTIONAL
@@ -306,6 +413,32 @@ int dma_xfer_prep_start_memcpy(struct dma_xfer *xfer, \
 		void * dma_cb_param, \
 		unsigned long flags);
 
+/**
+ *
+ * dma_xfer_submit - Queue a DMA transfer in the channel without
+ * starting it. Several transfers can be queued and then started
+ * at once with dma_async_issue_pending.
+ *
+ * @xfer: DMA Xfer pointer.
+ *
+ * Return: 0 if sucess and an error code otherwise.
+ *
+ */
+int dma_xfer_submit(struct dma_xfer * xfer);
+
+/**
+ *
+ * dma_xfer_set_callback - Change the callback of a prepared DMA Xfer.
+ * It must be called before the DMA Xfer is submitted.
+ *
+ * @xfer: DMA Xfer pointer.
+ * @dma_cb_f: DMA Callback function.
+ * @dma_cb_param: DMA Callback parameter.
+ *
+ */
+void dma_xfer_set_callback(struct dma_xfer * xfer, \
+	void (*dma_cb_f)(void * param), void * dma_cb_param);
+
 /**
  * 
  * dma_xfer_start - Start a DMA transfer.
@@ -328,6 +461,95 @@ int dma_xfer_start(struct dma_xfer * xfer);
  */
 enum dma_status dma_xfer_status(struct dma_xfer * xfer);
 
+/**
+ *
+ * dma_xfer_set_polled - Detach a prepared DMA Xfer from the DMA
+ * callback: its completion is reported by dma_xfer_poll instead
+ * (statistics, dma_xfer_wait, DMA Operation and user callback). It is
+ * meant for DMA Xfers prepared without DMA_PREP_INTERRUPT and it must
+ * be called before the DMA Xfer is submitted.
+ *
+ * @xfer: DMA Xfer pointer.
+ *
+ */
+void dma_xfer_set_polled(struct dma_xfer * xfer);
+
+/**
+ *
+ * dma_xfer_poll - Complete a polled DMA Xfer (see dma_xfer_set_polled)
+ * if the channel reports that it has finished. It must not be called
+ * again once it has returned 1.
+ *
+ * @xfer: DMA Xfer pointer.
+ *
+ * Return: 1 if the DMA Xfer has completed (it may be released by the
+ * user callback) and 0 if it is still in progress.
+ *
+ */
+int dma_xfer_poll(struct dma_xfer * xfer);
+
+/**
+ *
+ * dma_xfer_wait - Wait until a DMA Xfer has completed. The channel is
+ * polled during poll_ns first (for transfers of a few microseconds)
+ * and then the caller sleeps until the DMA callback.
+ *
+ * The DMA Xfer must have been prepared with DMA_PREP_INTERRUPT. It is
+ * not meant for cyclic transfers. During the poll window, it returns
+ * as soon as the channel reports the cookie as completed, usually
+ * before the DMA callback (which runs from the tasklet of the driver):
+ * the result is the one of tx_status and the DMA callback is still
+ * pending. In that case, dma_xfer_free and the next preparation wait
+ * for the DMA callback, so the channel must not be terminated before.
+ * After the sleep, it returns when the DMA callback has been called.
+ *
+ * @xfer: DMA Xfer pointer.
+ * @poll_ns: Busy-poll window (ns, 0: sleep at once).
+ * @timeout: Timeout (jiffies).
+ *
+ * Return: 0 if the DMA Xfer has completed, -1 if it has failed and
+ * -2 on timeout.
+ *
+ */
+int dma_xfer_wait(struct dma_xfer * xfer, u64 poll_ns, \
+	unsigned long timeout);
+
+/**
+ *
+ * dma_xfer_get_progress - Get the number of bytes transferred and the
+ * residue of a submitted DMA Xfer. The descriptors of a split SG
+ * transfer are taken into account.
+ *
+ * If the channel only reports the residue per descriptor, the bytes of
+ * the descriptor in progress are not counted until it completes.
+ *
+ * @xfer: DMA Xfer pointer.
+ * @progress: DMA Xfer progress.
+ *
+ * Return: 0 if success and an error code otherwise (DMA_ERROR or
+ * the DMA Xfer has not been submitted).
+ *
+ */
+int dma_xfer_get_progress(struct dma_xfer * xfer, \
+	struct dma_xfer_progress * progress);
+
+/**
+ *
+ * dma_xfer_sync_prefix - Give the transferred prefix of a SG transfer
+ * that is still in progress to the CPU. The part of the SG table that
+ * has been written since the last call is synced, so the consumer can
+ * process it while the rest of the transfer is in flight.
+ *
+ * The prefix follows the order of the DMA SG list of the DMA Xfer.
+ *
+ * @xfer: DMA Xfer pointer.
+ *
+ * Return: The number of bytes of the prefix that can be accessed
+ * by the CPU.
+ *
+ */
+size_t dma_xfer_sync_prefix(struct dma_xfer * xfer);
+
 /**
  * 
  * dma_xfer_free - Destroy a DMA Xfer.
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA-BUF DMA Block functions (implementation).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include <linux/slab.h>
+#include <linux/err.h>
+
+#include "dmabuf_dma_block.h"
+
+static void * dmabuf_dma_block_get_buffer(struct dma_block * block)
+{
+	/* The dma_buf is not mapped in the kernel address space */
+	return NULL;
+}
+
+static size_t dmabuf_dma_block_get_size(struct dma_block * block)
+{
+	struct dmabuf_dma_block * block_priv = block->priv;
+
+	return block_priv->dmabuf->size;
+}
+
+static int dmabuf_dma_block_get_sg_nents(struct dma_block * block, \
+	size_t offset, size_t len, unsigned int max_seg, \
+	unsigned long seg_boundary)
+{
+	/* The block can only be used through its mapped SG table */
+	return -1;
+}
+
+static int dmabuf_dma_block_setup_sg(struct dma_block * block, \
+	size_t offset, size_t len, unsigned int max_seg, \
+	unsigned long seg_boundary, struct scatterlist ** sg, int nents)
+{
+	return -1;
+}
+
+static struct sg_table * dmabuf_dma_block_get_dma_sg_table( \
+	struct dma_block * block, struct device * dev, \
+	enum dma_data_direction dir)
+{
+	struct dmabuf_dma_block * block_priv = block->priv;
+
+	if(block_priv->attach->dev != dev || block_priv->dir != dir)
+		return NULL;
+
+	return block_priv->sgt;
+}
+
+static struct dma_block_op dmabuf_dma_block_ops = {
+	.get_buffer = dmabuf_dma_block_get_buffer,
+	.get_size = dmabuf_dma_block_get_size,
+	.get_sg_nents = dmabuf_dma_block_get_sg_nents,
+	.setup_sg = dmabuf_dma_block_setup_sg,
+	.get_dma_sg_table = dmabuf_dma_block_get_dma_sg_table
+};
+
+struct dma_block * dmabuf_dma_block_create(struct dma_buf * dmabuf,\
+	struct device * dev, enum dma_data_direction dir, gfp_t gfp)
+{
+	struct dma_block * block;
+	struct dmabuf_dma_block * block_priv;
+
+	block = dma_block_create(sizeof(*block_priv),gfp);
+	if(block == NULL)
+		return NULL;
+
+	block_priv = block->priv;
+
+	get_dma_buf(dmabuf);
+	block_priv->dmabuf = dmabuf;
+	block_priv->dir = dir;
+
+	block_priv->attach = dma_buf_attach(dmabuf,dev);
+	if(IS_ERR(block_priv->attach)) {
+		dev_err(dev,"Couldn't attach the dma_buf \n");
+		goto err_attach;
+	}
+
+	block_priv->sgt = dma_buf_map_attachment_unlocked(block_priv->attach,\
+		dir);
+	if(IS_ERR(block_priv->sgt)) {
+		dev_err(dev,"Couldn't map the dma_buf \n");
+		goto err_map;
+	}
+
+	dma_block_op_bind(block,&dmabuf_dma_block_ops);
+
+	return block;
+
+err_map:
+	dma_buf_detach(dmabuf,block_priv->attach);
+err_attach:
+	dma_buf_put(dmabuf);
+	dma_block_free(block);
+
+	return NULL;
+}
+
+struct dma_block * dmabuf_dma_block_create_fd(int fd,\
+	struct device * dev, enum dma_data_direction dir, gfp_t gfp)
+{
+	struct dma_buf * dmabuf;
+	struct dma_block * block;
+
+	dmabuf = dma_buf_get(fd);
+	if(IS_ERR(dmabuf))
+		return NULL;
+
+	block = dmabuf_dma_block_create(dmabuf,dev,dir,gfp);
+
+	/* The block holds its own reference */
+	dma_buf_put(dmabuf);
+
+	return block;
+}
+
+void dmabuf_dma_block_free(struct dma_block * block)
+{
+	struct dmabuf_dma_block * block_priv = block->priv;
+
+	dma_buf_unmap_attachment_unlocked(block_priv->attach, \
+		block_priv->sgt,block_priv->dir);
+	dma_buf_detach(block_priv->dmabuf,block_priv->attach);
+	dma_buf_put(block_priv->dmabuf);
+
+	dma_block_free(block);
+}
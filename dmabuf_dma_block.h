@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * DMA-BUF DMA Block functions (header).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef DMABUF_DMA_BLOCK_H
+#define DMABUF_DMA_BLOCK_H
+
+#include <linux/types.h>
+#include <linux/device.h>
+#include <linux/dma-buf.h>
+#include <linux/dma-direction.h>
+
+#include "dma_block.h"
+
+/**
+ *
+ * DMA-BUF block structure. It imports a dma_buf exported by
+ * another driver (V4L2, DRM...) so that the DMA transfer uses
+ * its memory directly (zero-copy).
+ *
+ * The dma_buf is attached to the device and mapped when the block
+ * is created, and it is unmapped and detached when it is destroyed.
+ * The mapped SG table is used as it is by the DMA Xfer.
+ *
+ * The module that uses this block must import the DMA_BUF
+ * symbol namespace.
+ *
+ */
+struct dmabuf_dma_block {
+	/* Imported dma_buf (a reference is held) */
+	struct dma_buf * dmabuf;
+
+	/* Attachment to the DMA device */
+	struct dma_buf_attachment * attach;
+
+	/* Mapped SG table */
+	struct sg_table * sgt;
+
+	/* Mapping direction */
+	enum dma_data_direction dir;
+};
+
+/**
+ *
+ * dmabuf_dma_block_create - Create a new DMA-BUF DMA block.
+ * It takes its own reference to the dma_buf.
+ *
+ * @dmabuf: dma_buf to import.
+ * @dev: Device that performs the DMA transfers.
+ * @dir: DMA direction.
+ * @gfp: Specific flags to request memory.
+ *
+ * Return: A initialized DMA block or NULL on error.
+ *
+ */
+struct dma_block * dmabuf_dma_block_create(struct dma_buf * dmabuf,\
+	struct device * dev, enum dma_data_direction dir, gfp_t gfp);
+
+/**
+ *
+ * dmabuf_dma_block_create_fd - Create a new DMA-BUF DMA block from
+ * a dma_buf file descriptor (e.g. received from user space).
+ *
+ * @fd: dma_buf file descriptor.
+ * @dev: Device that performs the DMA transfers.
+ * @dir: DMA direction.
+ * @gfp: Specific flags to request memory.
+ *
+ * Return: A initialized DMA block or NULL on error.
+ *
+ */
+struct dma_block * dmabuf_dma_block_create_fd(int fd,\
+	struct device * dev, enum dma_data_direction dir, gfp_t gfp);
+
+/**
+ *
+ * dmabuf_dma_block_free - Destroy a DMA-BUF DMA block. The dma_buf
+ * is unmapped, detached and its reference released.
+ *
+ * @block: Block pointer.
+ *
+ */
+void dmabuf_dma_block_free(struct dma_block * block);
+
+#endif /* DMABUF_DMA_BLOCK_H */
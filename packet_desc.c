@@ -8,7 +8,10 @@
  * Version 2. See the file COPYING for more details.
 */
 
+#include <linux/pkt_sched.h>
+
 #include "packet_desc.h"
+#include "dma_opl_trace.h"
 
 /* Functions for packet_desc structure */
 
@@ -57,6 +60,50 @@ struct pdesc * pdesc_rx_create(struct dma_chan *dma_chan, \
 	return pdesc_create(dma_chan,block,PDESC_RX,id,dev,gfp);
 }
 
+static struct dma_stats * _pdesc_pool_stats(struct pdesc * desc)
+{
+	struct dma_xfer *xfer = \
+		list_first_entry(&desc->dma_op->list_dma_xfer,\
+		struct dma_xfer,node);
+
+	return xfer->pool_stats;
+}
+
+static u64 _pdesc_tstamp_delta(struct pdesc * desc, \
+	enum pdesc_tstamp from, enum pdesc_tstamp to)
+{
+	return ktime_to_ns(ktime_sub(desc->tstamps[to],desc->tstamps[from]));
+}
+
+/* DMA callback of the timestamped descriptors */
+static void _pdesc_xfer_callback(void * param)
+{
+	struct pdesc * desc = param;
+	struct dma_stats * stats = _pdesc_pool_stats(desc);
+
+	desc->tstamps[PDESC_TS_COMPLETE] = ktime_get();
+
+	dma_stats_lat(stats,DMA_STATS_LAT_PDESC_COMPLETE, \
+		_pdesc_tstamp_delta(desc,PDESC_TS_SUBMIT,PDESC_TS_COMPLETE));
+	dma_stats_lat(stats,DMA_STATS_LAT_PDESC_TOTAL, \
+		_pdesc_tstamp_delta(desc,PDESC_TS_CREATE,PDESC_TS_COMPLETE));
+
+	if(desc->dma_cb_f != NULL)
+		desc->dma_cb_f(desc->dma_cb_param);
+}
+
+void pdesc_tstamp_enable(struct pdesc * desc)
+{
+	memset(desc->tstamps,0,sizeof(desc->tstamps));
+	desc->tstamps[PDESC_TS_CREATE] = ktime_get();
+	desc->tstamp_on = 1;
+}
+
+ktime_t pdesc_tstamp_get(struct pdesc * desc, enum pdesc_tstamp ts)
+{
+	return desc->tstamps[ts];
+}
+
 int pdesc_xfer_prep(struct pdesc *desc, \
 	void (*dma_cb_f)(void * param), \
 	void * dma_cb_param, \
@@ -69,6 +116,17 @@ int pdesc_xfer_prep(struct pdesc *desc, \
 		struct dma_xfer,node);
 	int r = 0;
 	
+	if(desc->tstamp_on) {
+		desc->tstamps[PDESC_TS_PREP] = ktime_get();
+		desc->tstamps[PDESC_TS_SUBMIT] = 0;
+		desc->tstamps[PDESC_TS_COMPLETE] = 0;
+		
+		desc->dma_cb_f = dma_cb_f;
+		desc->dma_cb_param = dma_cb_param;
+		dma_cb_f = _pdesc_xfer_callback;
+		dma_cb_param = desc;
+	}
+	
 	/** Map the DMA SG of the DMA transfer **/
 	r = dma_xfer_map_sg(xfer, \
 		(desc->pdesc_t == PDESC_TX) ? DMA_TO_DEVICE : DMA_FROM_DEVICE,\
@@ -84,22 +142,33 @@ int pdesc_xfer_prep(struct pdesc *desc, \
 	return r;
 }
 
+static void _pdesc_tstamp_submit(struct pdesc * desc)
+{
+	if(desc->tstamp_on) {
+		desc->tstamps[PDESC_TS_SUBMIT] = ktime_get();
+		dma_stats_lat(_pdesc_pool_stats(desc),DMA_STATS_LAT_PDESC_PREP, \
+			_pdesc_tstamp_delta(desc,PDESC_TS_PREP,PDESC_TS_SUBMIT));
+	}
+}
+
 int pdesc_xfer_start(struct pdesc * desc)
 {
+	_pdesc_tstamp_submit(desc);
+	
 	return dma_op_start(desc->dma_op);
 }
 
 void pdesc_tstamp_set(struct pdesc * desc, \
-	struct timespec ts)
+	ktime_t ts)
 {
 	struct skb_shared_hwtstamps *hwts;
 
 	hwts = skb_hwtstamps(desc->skb);
-	hwts->hwtstamp = timespec_to_ktime(ts);
+	hwts->hwtstamp = ts;
 }
 
 void pdesc_copy_from(struct pdesc * desc, \
-	struct sk_buff * skb, struct timespec * ts)
+	struct sk_buff * skb, struct timespec64 * ts)
 {
 	size_t size = desc->block->op->get_size(desc->block);
 	unsigned char * pbuf = desc->block->op->get_buffer(desc->block);
@@ -107,22 +176,27 @@ void pdesc_copy_from(struct pdesc * desc, \
 
 	desc->skb = skb;
 	memcpy(pskb,pbuf,size);
+	trace_pdesc_copy_from(desc,size);
 
 	if(ts != NULL)
-		pdesc_tstamp_set(desc,*ts);
+		pdesc_tstamp_set(desc,timespec64_to_ktime(*ts));
+	else if(desc->tstamp_on && desc->tstamps[PDESC_TS_COMPLETE] != 0)
+		pdesc_tstamp_set(desc, \
+			ktime_mono_to_real(desc->tstamps[PDESC_TS_COMPLETE]));
 }
 
 void pdesc_copy_to(struct pdesc * desc, \
-	struct sk_buff * skb, struct timespec * ts)
+	struct sk_buff * skb, struct timespec64 * ts)
 {
 	unsigned char * pbuf = desc->block->op->get_buffer(desc->block);
 	unsigned char * pskb = skb->data;
 
 	desc->skb = skb;
 	memcpy(pbuf,pskb,skb->len);
+	trace_pdesc_copy_to(desc,skb->len);
 
 	if(ts != NULL)
-		pdesc_tstamp_set(desc,*ts);
+		pdesc_tstamp_set(desc,timespec64_to_ktime(*ts));
 }
 
 void pdesc_free(struct pdesc * desc)
@@ -151,22 +225,139 @@ struct pdesc_pool * pdesc_pool_create(gfp_t gfp)
 {
 	struct pdesc_pool * pool = NULL;
 
+	unsigned int i;
+
 	pool = kzalloc(sizeof(*pool),gfp);
-	if(pool != NULL)
+	if(pool != NULL) {
 		INIT_LIST_HEAD(&pool->list_pdesc);
+		spin_lock_init(&pool->lock);
+		
+		for(i = 0; i < PDESC_NPRIOS; i++)
+			INIT_LIST_HEAD(&pool->lanes[i].list_pending);
+		pool->tc_prio[TC_PRIO_CONTROL] = PDESC_PRIO_HIGH;
+	}
 
 	return pool;
 }
 
+int pdesc_pool_stats_register(struct pdesc_pool * pool, const char * name)
+{
+	if(pool->stats != NULL)
+		return -1;
+
+	pool->stats = dma_stats_create(DMA_STATS_POOL,name);
+
+	return (pool->stats != NULL) ? 0 : -2;
+}
+
+void pdesc_pool_set_lane(struct pdesc_pool * pool, enum pdesc_prio prio, \
+	struct dma_chan * chan)
+{
+	pool->lanes[prio].chan = chan;
+}
+
+struct dma_chan * pdesc_pool_lane_chan(struct pdesc_pool * pool, u8 tc)
+{
+	struct dma_chan * chan;
+
+	chan = pool->lanes[pool->tc_prio[tc % PDESC_POOL_NTCS]].chan;
+	if(chan == NULL)
+		chan = pool->lanes[PDESC_PRIO_BULK].chan;
+
+	return chan;
+}
+
+void pdesc_pool_set_tc(struct pdesc_pool * pool, u8 tc, \
+	enum pdesc_prio prio)
+{
+	pool->tc_prio[tc % PDESC_POOL_NTCS] = prio;
+}
+
+void pdesc_pool_queue(struct pdesc_pool * pool, struct pdesc * desc, u8 tc)
+{
+	struct pdesc_lane * lane = \
+		&pool->lanes[pool->tc_prio[tc % PDESC_POOL_NTCS]];
+	unsigned long flags;
+
+	spin_lock_irqsave(&pool->lock,flags);
+	list_add_tail(&desc->lane_node,&lane->list_pending);
+	spin_unlock_irqrestore(&pool->lock,flags);
+}
+
+static struct dma_chan * _pdesc_chan(struct pdesc * desc)
+{
+	struct dma_xfer *xfer = \
+		list_first_entry(&desc->dma_op->list_dma_xfer,\
+		struct dma_xfer,node);
+
+	return xfer->dma_chan;
+}
+
+int pdesc_pool_kick(struct pdesc_pool * pool)
+{
+	struct list_head pending[PDESC_NPRIOS];
+	struct dma_chan * chan;
+	struct dma_chan * last;
+	struct pdesc * desc;
+	struct pdesc * aux;
+	unsigned long flags;
+	int failed = 0;
+	int i;
+
+	spin_lock_irqsave(&pool->lock,flags);
+	for(i = 0; i < PDESC_NPRIOS; i++) {
+		INIT_LIST_HEAD(&pending[i]);
+		list_splice_init(&pool->lanes[i].list_pending,&pending[i]);
+	}
+	spin_unlock_irqrestore(&pool->lock,flags);
+
+	/* The high priority descriptors go first, even on a shared channel */
+	for(i = PDESC_NPRIOS-1; i >= 0; i--) {
+		last = NULL;
+		
+		list_for_each_entry_safe(desc,aux,&pending[i],lane_node) {
+			list_del(&desc->lane_node);
+			
+			chan = _pdesc_chan(desc);
+			if(last != NULL && chan != last)
+				dma_async_issue_pending(last);
+			last = chan;
+			
+			_pdesc_tstamp_submit(desc);
+			if(dma_op_submit(desc->dma_op) != 0)
+				failed++;
+		}
+		
+		if(last != NULL)
+			dma_async_issue_pending(last);
+	}
+
+	return failed;
+}
+
+static void _pdesc_set_pool_stats(struct pdesc * desc, \
+	struct dma_stats * stats)
+{
+	struct list_head * p;
+	struct dma_xfer * xfer;
+
+	list_for_each(p,&desc->dma_op->list_dma_xfer) {
+		xfer = list_entry(p,struct dma_xfer,node);
+		xfer->pool_stats = stats;
+	}
+}
+
 int pdesc_pool_add(struct pdesc_pool * pool, \
 		struct pdesc * desc)
 {
 	int r = 0;
 
-	if(pool != NULL && desc != NULL)
+	if(pool != NULL && desc != NULL) {
 		list_add_tail(&desc->node,&pool->list_pdesc);
-	else
+		_pdesc_set_pool_stats(desc,pool->stats);
+	} else {
 		r = -1;
+	}
 
 	return r;
 }
@@ -177,10 +368,12 @@ int pdesc_pool_del(struct pdesc_pool * pool, \
 {
 	int r = 0;
 
-	if(pool != NULL && desc != NULL)
+	if(pool != NULL && desc != NULL) {
 		list_del(&desc->node);
-	else
+		_pdesc_set_pool_stats(desc,NULL);
+	} else {
 		r = -1;
+	}
 
 	return r;
 }
@@ -221,12 +414,22 @@ struct pdesc * pdesc_pool_find(struct pdesc_pool * pool, \
 	
 	if(!found)
 		pd = NULL;
+	
+	trace_pdesc_pool_find(pool,frame_id,pd);
 		
 	return pd;
 }
 
 void pdesc_pool_free(struct pdesc_pool * pool)
 {
-	if(pool != NULL)
+	struct pdesc * desc;
+
+	if(pool != NULL) {
+		/* The descriptors may outlive the pool and its statistics */
+		list_for_each_entry(desc,&pool->list_pdesc,node)
+			_pdesc_set_pool_stats(desc,NULL);
+
+		dma_stats_free(pool->stats);
 		kfree(pool);
+	}
 }
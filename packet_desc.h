@@ -13,13 +13,18 @@
 
 #include <linux/list.h>
 #include <linux/types.h>
-#include <linux/time.h>
+#include <linux/time64.h>
+#include <linux/ktime.h>
 #include <linux/device.h>
 #include <linux/scatterlist.h>
 #include <linux/spinlock.h>
 #include <linux/skbuff.h>
+#include <linux/rbtree.h>
 
 #include "dma_op.h"
+#include "dma_stats.h"
+
+struct pdesc_cmode;
 
 /**
  * 
@@ -34,6 +39,24 @@ enum pdesc_type {
 	PDESC_TX = 1
 };
 
+/**
+ *
+ * Packet descriptor timestamps.
+ *
+ * @PDESC_TS_CREATE: Creation (pdesc_tstamp_enable).
+ * @PDESC_TS_PREP: Start of pdesc_xfer_prep.
+ * @PDESC_TS_SUBMIT: Start of pdesc_xfer_start.
+ * @PDESC_TS_COMPLETE: DMA completion callback.
+ *
+ */
+enum pdesc_tstamp {
+	PDESC_TS_CREATE,
+	PDESC_TS_PREP,
+	PDESC_TS_SUBMIT,
+	PDESC_TS_COMPLETE,
+	PDESC_NTSTAMPS
+};
+
 /**
  *
  * Packet descriptor structure. It stores all the
@@ -55,6 +78,27 @@ struct pdesc {
 	/* Packet ID */
 	u16 id;
 
+	/* Timestamps (only if tstamp_on is set) */
+	int tstamp_on;
+	ktime_t tstamps[PDESC_NTSTAMPS];
+
+	/* DMA callback of the user (timestamped descriptors) */
+	void (*dma_cb_f)(void * param);
+	void * dma_cb_param;
+
+	/* Pending batch of a priority lane (see pdesc_pool_queue) */
+	struct list_head lane_node;
+
+	/* Launch time queue (see pdesc_txtime_queue) */
+	struct rb_node txtime_node;
+	ktime_t txtime;
+
+	/* Completion mode controller (see pdesc_cmode_prep) */
+	struct pdesc_cmode * cmode;
+	int cmode_polled;
+	int cmode_status;
+	struct list_head cmode_node;
+
 	/* Linked list of packet descriptors */
 	struct list_head node;
 };
@@ -143,6 +187,35 @@ int pdesc_xfer_prep(struct pdesc *desc, \
  */
 int pdesc_xfer_start(struct pdesc * desc);
 
+/**
+ *
+ * pdesc_tstamp_enable - Record the timestamps of the Packet
+ * descriptor (see enum pdesc_tstamp). It should be called right after
+ * pdesc_create, since it takes the creation timestamp. The latencies
+ * feed the histograms of the pool of the descriptor, if any.
+ *
+ * The completion timestamp is taken by a DMA callback of the
+ * descriptor that calls the user callback, so the descriptor must
+ * not be freed until its DMA callback has run.
+ *
+ * @desc: A Packet descriptor pointer.
+ *
+ */
+void pdesc_tstamp_enable(struct pdesc * desc);
+
+/**
+ *
+ * pdesc_tstamp_get - Get a timestamp of the Packet descriptor.
+ *
+ * @desc: A Packet descriptor pointer.
+ * @ts: Timestamp.
+ *
+ * Return: The timestamp (CLOCK_MONOTONIC) or 0 if it hasn't been
+ * recorded.
+ *
+ */
+ktime_t pdesc_tstamp_get(struct pdesc * desc, enum pdesc_tstamp ts);
+
 /**
  * 
  * pdesc_tstamp_set - Store the timestamp with the sk_buff kernel
@@ -153,7 +226,7 @@ int pdesc_xfer_start(struct pdesc * desc);
  * 
  */
 void pdesc_tstamp_set(struct pdesc * desc, \
-	struct timespec ts);
+	ktime_t ts);
 
 /**
  *
@@ -162,24 +235,26 @@ void pdesc_tstamp_set(struct pdesc * desc, \
  *
  * @desc: A Packet descriptor pointer.
  * @skb: A networking layer structure pointer.
- * @ts: Packet timestamp if any.
+ * @ts: Packet timestamp if any. If it is NULL, the DMA completion
+ * timestamp is used (timestamped descriptors, CLOCK_REALTIME).
  *
  */
 void pdesc_copy_from(struct pdesc * desc, \
-	struct sk_buff * skb, struct timespec * ts);
+	struct sk_buff * skb, struct timespec64 * ts);
 
 /**
  *
- * pdesc_copy_from - Copy the data from the sk_buff
+ * pdesc_copy_to - Copy the data from the sk_buff
  * (networking layer structure) to the packet descriptor.
  *
  * @desc: A Packet descriptor pointer.
  * @skb: A networking layer structure pointer.
- * @ts: Packet timestamp if any.
+ * @ts: Packet timestamp if any. The DMA completion timestamp of a TX
+ * descriptor can be stored later with pdesc_tstamp_set.
  *
  */
 void pdesc_copy_to(struct pdesc * desc, \
-	struct sk_buff * skb, struct timespec * ts);
+	struct sk_buff * skb, struct timespec64 * ts);
 
 /**
  *
@@ -190,6 +265,35 @@ void pdesc_copy_to(struct pdesc * desc, \
  */
 void pdesc_free(struct pdesc * desc);
 
+/**
+ *
+ * Packet descriptor priority lanes.
+ *
+ * @PDESC_PRIO_BULK: Bulk traffic.
+ * @PDESC_PRIO_HIGH: Time-critical traffic (e.g. PTP event frames).
+ *
+ */
+enum pdesc_prio {
+	PDESC_PRIO_BULK = 0,
+	PDESC_PRIO_HIGH = 1,
+	PDESC_NPRIOS
+};
+
+/* Number of traffic classes (e.g. skb->priority & 7) */
+#define PDESC_POOL_NTCS 8
+
+/**
+ *
+ * Packet descriptor priority lane. A lane without its own DMA channel
+ * shares the channel of the bulk lane: its descriptors are submitted
+ * at the head of the pending batch.
+ *
+ */
+struct pdesc_lane {
+	struct dma_chan * chan;
+	struct list_head list_pending;
+};
+
 /**
  *
  * Packet descriptor pool structure. It contains several
@@ -198,6 +302,14 @@ void pdesc_free(struct pdesc * desc);
  */
 struct pdesc_pool {
 	struct list_head list_pdesc;
+	
+	/* Statistics of the pool (NULL if they are not enabled) */
+	struct dma_stats * stats;
+	
+	/* Priority lanes and traffic class to lane map */
+	struct pdesc_lane lanes[PDESC_NPRIOS];
+	u8 tc_prio[PDESC_POOL_NTCS];
+	spinlock_t lock;
 };
 
 /**
@@ -211,6 +323,84 @@ struct pdesc_pool {
  */
 struct pdesc_pool * pdesc_pool_create(gfp_t gfp);
 
+/**
+ *
+ * pdesc_pool_stats_register - Enable the statistics of the pool
+ * (dma_opl/pool/<name>). The Packet descriptors added to the pool
+ * after this call update them.
+ *
+ * @pool : Packet descriptor pool pointer.
+ * @name : Name of the pool.
+ *
+ * Return: 0 if sucess and an error code otherwise.
+ *
+ */
+int pdesc_pool_stats_register(struct pdesc_pool * pool, const char * name);
+
+/**
+ *
+ * pdesc_pool_set_lane - Set the DMA channel of a priority lane.
+ *
+ * @pool : Packet descriptor pool pointer.
+ * @prio : Priority lane.
+ * @chan : DMA channel or NULL to share the channel of the bulk lane.
+ *
+ */
+void pdesc_pool_set_lane(struct pdesc_pool * pool, enum pdesc_prio prio, \
+	struct dma_chan * chan);
+
+/**
+ *
+ * pdesc_pool_lane_chan - Get the DMA channel that the Packet
+ * descriptors of a traffic class must be created with.
+ *
+ * @pool : Packet descriptor pool pointer.
+ * @tc : Traffic class.
+ *
+ * Return: The DMA channel of the lane of the traffic class.
+ *
+ */
+struct dma_chan * pdesc_pool_lane_chan(struct pdesc_pool * pool, u8 tc);
+
+/**
+ *
+ * pdesc_pool_set_tc - Map a traffic class to a priority lane. By
+ * default, the traffic class 7 (TC_PRIO_CONTROL) goes to the high
+ * priority lane and the others to the bulk lane.
+ *
+ * @pool : Packet descriptor pool pointer.
+ * @tc : Traffic class.
+ * @prio : Priority lane.
+ *
+ */
+void pdesc_pool_set_tc(struct pdesc_pool * pool, u8 tc, \
+	enum pdesc_prio prio);
+
+/**
+ *
+ * pdesc_pool_queue - Queue a prepared Packet descriptor in the pending
+ * batch of the lane of its traffic class. It can be called from any
+ * context.
+ *
+ * @pool : Packet descriptor pool pointer.
+ * @desc : Packet descriptor pointer (see pdesc_xfer_prep).
+ * @tc : Traffic class.
+ *
+ */
+void pdesc_pool_queue(struct pdesc_pool * pool, struct pdesc * desc, u8 tc);
+
+/**
+ *
+ * pdesc_pool_kick - Submit the pending batches, the high priority lane
+ * first, and issue them with one dma_async_issue_pending per lane.
+ *
+ * @pool : Packet descriptor pool pointer.
+ *
+ * Return: The number of Packet descriptors that couldn't be submitted.
+ *
+ */
+int pdesc_pool_kick(struct pdesc_pool * pool);
+
 /**
  *
  * pdesc_pool_add - Add a new Packet descriptor to the pool.
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * Packet descriptor completion mode controller (implementation).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include <linux/slab.h>
+#include <linux/math64.h>
+
+#include "pdesc_cmode.h"
+
+static struct dma_xfer * _pdesc_cmode_xfer(struct pdesc * desc)
+{
+	return list_first_entry(&desc->dma_op->list_dma_xfer, \
+		struct dma_xfer,node);
+}
+
+/*
+ * Account n completions and switch the mode at the end of the window
+ * (lock held). The rate is normalized to the window, since the window
+ * is only closed when there is activity.
+ */
+static void _pdesc_cmode_update(struct pdesc_cmode * cm, unsigned long n)
+{
+	ktime_t now = ktime_get();
+	u64 elapsed = ktime_to_ns(ktime_sub(now,cm->window_start));
+	u64 rate;
+
+	cm->count += n;
+	if(elapsed < cm->window_ns)
+		return;
+
+	rate = div64_u64((u64) cm->count*cm->window_ns,elapsed);
+
+	if(cm->mode == PDESC_CMODE_IRQ && rate >= cm->high) {
+		cm->mode = PDESC_CMODE_POLL;
+		cm->switches++;
+	} else if(cm->mode == PDESC_CMODE_POLL && rate <= cm->low) {
+		cm->mode = PDESC_CMODE_IRQ;
+		cm->switches++;
+	}
+
+	cm->count = 0;
+	cm->window_start = now;
+}
+
+/* Interrupt mode: DMA callback of each descriptor */
+static void _pdesc_cmode_callback(void * param)
+{
+	struct pdesc * desc = param;
+	struct pdesc_cmode * cm = desc->cmode;
+	int status = (_pdesc_cmode_xfer(desc)->dma_result == \
+		DMA_TRANS_NOERROR) ? 0 : -1;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cm->lock,flags);
+	_pdesc_cmode_update(cm,1);
+	spin_unlock_irqrestore(&cm->lock,flags);
+
+	cm->done_f(desc,status,cm->done_param);
+}
+
+/* Poll mode: reap the completed descriptors in submission order */
+static enum hrtimer_restart _pdesc_cmode_timer(struct hrtimer * timer)
+{
+	struct pdesc_cmode * cm = container_of(timer,struct pdesc_cmode,timer);
+	struct pdesc * desc;
+	struct pdesc * aux;
+	enum dma_status status;
+	unsigned long flags;
+	unsigned long n = 0;
+	int restart;
+	LIST_HEAD(done);
+
+	spin_lock_irqsave(&cm->lock,flags);
+
+	list_for_each_entry_safe(desc,aux,&cm->list_pending,cmode_node) {
+		status = dma_xfer_status(_pdesc_cmode_xfer(desc));
+		if(status == DMA_IN_PROGRESS || status == DMA_PAUSED)
+			break;
+
+		desc->cmode_status = (status == DMA_COMPLETE) ? 0 : -1;
+		list_move_tail(&desc->cmode_node,&done);
+		n++;
+	}
+
+	_pdesc_cmode_update(cm,n);
+
+	restart = !list_empty(&cm->list_pending);
+	if(!restart)
+		cm->timer_on = 0;
+
+	spin_unlock_irqrestore(&cm->lock,flags);
+
+	/*
+	 * Account the completion as the DMA callback would (statistics,
+	 * timestamps, waiters and DMA Operation) outside of the lock.
+	 */
+	list_for_each_entry_safe(desc,aux,&done,cmode_node) {
+		list_del(&desc->cmode_node);
+		dma_xfer_poll(_pdesc_cmode_xfer(desc));
+		cm->done_f(desc,desc->cmode_status,cm->done_param);
+	}
+
+	if(!restart)
+		return HRTIMER_NORESTART;
+
+	hrtimer_forward_now(timer,ns_to_ktime(cm->poll_ns));
+
+	return HRTIMER_RESTART;
+}
+
+struct pdesc_cmode * pdesc_cmode_create(u64 window_ns, unsigned long low, \
+	unsigned long high, u64 poll_ns, \
+	void (*done_f)(struct pdesc * desc, int status, void * param), \
+	void * done_param, gfp_t gfp)
+{
+	struct pdesc_cmode * cm = NULL;
+
+	cm = kzalloc(sizeof(*cm),gfp);
+	if(cm != NULL) {
+		cm->mode = PDESC_CMODE_IRQ;
+		spin_lock_init(&cm->lock);
+
+		cm->window_ns = window_ns;
+		cm->window_start = ktime_get();
+		cm->low = low;
+		cm->high = high;
+
+		INIT_LIST_HEAD(&cm->list_pending);
+		hrtimer_setup(&cm->timer,_pdesc_cmode_timer,CLOCK_MONOTONIC, \
+			HRTIMER_MODE_REL_SOFT);
+		cm->poll_ns = poll_ns;
+
+		cm->done_f = done_f;
+		cm->done_param = done_param;
+	}
+
+	return cm;
+}
+
+int pdesc_cmode_prep(struct pdesc_cmode * cm, struct pdesc * desc, \
+	unsigned long flags, void * context, gfp_t gfp)
+{
+	unsigned long lflags;
+	int r;
+
+	spin_lock_irqsave(&cm->lock,lflags);
+	desc->cmode_polled = (cm->mode == PDESC_CMODE_POLL);
+	spin_unlock_irqrestore(&cm->lock,lflags);
+
+	desc->cmode = cm;
+
+	if(desc->cmode_polled) {
+		r = pdesc_xfer_prep(desc,NULL,NULL, \
+			flags & ~DMA_PREP_INTERRUPT,context,gfp);
+		if(r == 0)
+			dma_xfer_set_polled(_pdesc_cmode_xfer(desc));
+
+		return r;
+	}
+
+	return pdesc_xfer_prep(desc,_pdesc_cmode_callback,desc, \
+		flags | DMA_PREP_INTERRUPT,context,gfp);
+}
+
+int pdesc_cmode_start(struct pdesc_cmode * cm, struct pdesc * desc)
+{
+	unsigned long flags;
+	int polled = desc->cmode_polled;
+	int r;
+
+	/* In interrupt mode, the descriptor may be released after this */
+	r = pdesc_xfer_start(desc);
+
+	spin_lock_irqsave(&cm->lock,flags);
+
+	/* The rate also falls when nothing completes */
+	_pdesc_cmode_update(cm,0);
+
+	if(r == 0 && polled) {
+		list_add_tail(&desc->cmode_node,&cm->list_pending);
+		if(!cm->timer_on) {
+			cm->timer_on = 1;
+			hrtimer_start(&cm->timer,ns_to_ktime(cm->poll_ns), \
+				HRTIMER_MODE_REL_SOFT);
+		}
+	}
+
+	spin_unlock_irqrestore(&cm->lock,flags);
+
+	return r;
+}
+
+void pdesc_cmode_free(struct pdesc_cmode * cm)
+{
+	if(cm != NULL) {
+		hrtimer_cancel(&cm->timer);
+		kfree(cm);
+	}
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * Packet descriptor completion mode controller (header).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef PDESC_CMODE_H
+#define PDESC_CMODE_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/hrtimer.h>
+#include <linux/spinlock.h>
+
+#include "packet_desc.h"
+
+/**
+ *
+ * Completion modes.
+ *
+ * @PDESC_CMODE_IRQ: One DMA interrupt (callback) per descriptor.
+ * @PDESC_CMODE_POLL: No DMA interrupts: the completed descriptors are
+ *	reaped in batches from a timer.
+ *
+ */
+enum pdesc_cmode_mode {
+	PDESC_CMODE_IRQ,
+	PDESC_CMODE_POLL
+};
+
+/**
+ *
+ * Packet descriptor completion mode controller. It measures the
+ * completion rate of a DMA channel in windows of window_ns and it
+ * switches to poll mode when the rate reaches high and back to
+ * interrupt mode when it falls to low (hysteresis).
+ *
+ */
+struct pdesc_cmode {
+	enum pdesc_cmode_mode mode;
+	spinlock_t lock;
+
+	/* Completion rate (completions per window) */
+	u64 window_ns;
+	ktime_t window_start;
+	unsigned long count;
+	unsigned long low;
+	unsigned long high;
+
+	/* Poll mode: descriptors in flight (submission order) and timer */
+	struct list_head list_pending;
+	struct hrtimer timer;
+	u64 poll_ns;
+	int timer_on;
+
+	/* Called when a descriptor has completed */
+	void (*done_f)(struct pdesc * desc, int status, void * param);
+	void * done_param;
+
+	/* Mode switches */
+	unsigned long switches;
+};
+
+/**
+ *
+ * pdesc_cmode_create - Create a new completion mode controller. It
+ * starts in interrupt mode.
+ *
+ * @window_ns: Rate measurement window.
+ * @low: Rate (completions per window) to go back to interrupt mode.
+ * @high: Rate (completions per window) to go to poll mode.
+ * @poll_ns: Poll period.
+ * @done_f: Function called with each completed descriptor and its
+ *	status (0 or -1 on error), from the DMA callback or from the poll
+ *	timer (softirq).
+ * @done_param: Parameter of done_f.
+ * @gfp: Specific flags to request memory.
+ *
+ * Return: A completion mode controller.
+ *
+ */
+struct pdesc_cmode * pdesc_cmode_create(u64 window_ns, unsigned long low, \
+	unsigned long high, u64 poll_ns, \
+	void (*done_f)(struct pdesc * desc, int status, void * param), \
+	void * done_param, gfp_t gfp);
+
+/**
+ *
+ * pdesc_cmode_prep - Prepare a Packet descriptor for the current mode
+ * (see pdesc_xfer_prep). DMA_PREP_INTERRUPT is set or cleared in flags.
+ * In poll mode, the completion is accounted by the poll timer (see
+ * dma_xfer_poll), so statistics, timestamps and waiters still work.
+ *
+ * @cm: Completion mode controller pointer.
+ * @desc: Packet descriptor pointer.
+ * @flags: DMA controller flags.
+ * @context: Extra arguments for some DMA drivers.
+ * @gfp: Specific flags to request memory.
+ *
+ * Return: 0 if success and an error code otherwise.
+ *
+ */
+int pdesc_cmode_prep(struct pdesc_cmode * cm, struct pdesc * desc, \
+	unsigned long flags, void * context, gfp_t gfp);
+
+/**
+ *
+ * pdesc_cmode_start - Start a Packet descriptor prepared with
+ * pdesc_cmode_prep.
+ *
+ * @cm: Completion mode controller pointer.
+ * @desc: Packet descriptor pointer.
+ *
+ * Return: 0 if success and an error code otherwise.
+ *
+ */
+int pdesc_cmode_start(struct pdesc_cmode * cm, struct pdesc * desc);
+
+/**
+ *
+ * pdesc_cmode_free - Destroy a completion mode controller. The
+ * descriptors must have completed.
+ *
+ * @cm: Completion mode controller pointer.
+ *
+ */
+void pdesc_cmode_free(struct pdesc_cmode * cm);
+
+#endif /* PDESC_CMODE_H */
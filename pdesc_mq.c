@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * Multi-queue Packet descriptor pools (implementation).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include <linux/slab.h>
+#include <linux/cpumask.h>
+#include <linux/interrupt.h>
+
+#include "pdesc_mq.h"
+
+static const char * const pdesc_mq_dir_names[] = {
+	"tx", "rx"
+};
+
+static struct pdesc_mq_queue * _pdesc_mq_queue(struct pdesc_mq * mq, \
+	enum pdesc_mq_dir dir, unsigned int index)
+{
+	if(dir >= PDESC_MQ_NDIRS || index >= mq->nqueues[dir])
+		return NULL;
+
+	return &mq->queues[dir][index];
+}
+
+static void _pdesc_mq_unbind(struct pdesc_mq_queue * q)
+{
+	if(q->irq >= 0)
+		irq_update_affinity_hint(q->irq,NULL);
+
+	q->cpu = -1;
+	q->irq = -1;
+	q->chan = NULL;
+	if(q->pool != NULL)
+		pdesc_pool_set_lane(q->pool,PDESC_PRIO_BULK,NULL);
+}
+
+struct pdesc_mq * pdesc_mq_create(const char * name, unsigned int ntx, \
+	unsigned int nrx, gfp_t gfp)
+{
+	struct pdesc_mq * mq = NULL;
+	struct pdesc_mq_queue * q;
+	char qname[64];
+	unsigned int i;
+	int d;
+
+	/* The stack always has a TX queue to map the sk_buffs to */
+	if(ntx == 0)
+		return NULL;
+
+	mq = kzalloc(sizeof(*mq),gfp);
+	if(mq == NULL)
+		return NULL;
+
+	mq->nqueues[PDESC_MQ_TX] = ntx;
+	mq->nqueues[PDESC_MQ_RX] = nrx;
+
+	for(d = 0; d < PDESC_MQ_NDIRS; d++) {
+		mq->queues[d] = kcalloc(mq->nqueues[d],sizeof(*q),gfp);
+		if(mq->queues[d] == NULL && mq->nqueues[d] != 0)
+			goto err;
+
+		for(i = 0; i < mq->nqueues[d]; i++) {
+			mq->queues[d][i].cpu = -1;
+			mq->queues[d][i].irq = -1;
+		}
+
+		for(i = 0; i < mq->nqueues[d]; i++) {
+			q = &mq->queues[d][i];
+			q->pool = pdesc_pool_create(gfp);
+			if(q->pool == NULL)
+				goto err;
+
+			if(name != NULL) {
+				snprintf(qname,sizeof(qname),"%s-%s%u",name, \
+					pdesc_mq_dir_names[d],i);
+				pdesc_pool_stats_register(q->pool,qname);
+			}
+		}
+	}
+
+	return mq;
+
+err:
+	pdesc_mq_free(mq);
+
+	return NULL;
+}
+
+int pdesc_mq_bind(struct pdesc_mq * mq, enum pdesc_mq_dir dir, \
+	unsigned int index, struct dma_chan * chan, int cpu, int irq)
+{
+	struct pdesc_mq_queue * q = _pdesc_mq_queue(mq,dir,index);
+	int r;
+
+	if(q == NULL || chan == NULL)
+		return -1;
+
+	if(cpu >= 0 && (cpu >= nr_cpu_ids || !cpu_possible(cpu)))
+		return -1;
+
+	_pdesc_mq_unbind(q);
+
+	/* The queue is only bound if the IRQ can follow the CPU */
+	if(cpu >= 0 && irq >= 0) {
+		r = irq_set_affinity_and_hint(irq,cpumask_of(cpu));
+		if(r < 0) {
+			dev_err(chan->device->dev,"Affinity of IRQ %d failed \n", \
+				irq);
+			return -2;
+		}
+		q->irq = irq;
+	}
+
+	q->cpu = cpu;
+	q->chan = chan;
+	pdesc_pool_set_lane(q->pool,PDESC_PRIO_BULK,chan);
+
+	return 0;
+}
+
+int pdesc_mq_set_xps(struct pdesc_mq * mq, struct net_device * dev)
+{
+	struct pdesc_mq_queue * q;
+	unsigned int i;
+	int r;
+
+	for(i = 0; i < mq->nqueues[PDESC_MQ_TX]; i++) {
+		q = &mq->queues[PDESC_MQ_TX][i];
+		if(q->cpu < 0)
+			continue;
+
+		r = netif_set_xps_queue(dev,cpumask_of(q->cpu),i);
+		if(r < 0) {
+			netdev_err(dev,"XPS map of TX queue %u failed \n",i);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+struct pdesc_pool * pdesc_mq_pool(struct pdesc_mq * mq, \
+	enum pdesc_mq_dir dir, unsigned int index)
+{
+	struct pdesc_mq_queue * q = _pdesc_mq_queue(mq,dir,index);
+
+	return (q != NULL) ? q->pool : NULL;
+}
+
+struct pdesc_pool * pdesc_mq_tx_pool(struct pdesc_mq * mq, \
+	struct sk_buff * skb)
+{
+	/* The stack picks a valid queue, but the netdev may have more */
+	return mq->queues[PDESC_MQ_TX][skb_get_queue_mapping(skb) % \
+		mq->nqueues[PDESC_MQ_TX]].pool;
+}
+
+void pdesc_mq_free(struct pdesc_mq * mq)
+{
+	struct pdesc_mq_queue * q;
+	unsigned int i;
+	int d;
+
+	if(mq != NULL) {
+		for(d = 0; d < PDESC_MQ_NDIRS; d++) {
+			if(mq->queues[d] == NULL)
+				continue;
+
+			for(i = 0; i < mq->nqueues[d]; i++) {
+				q = &mq->queues[d][i];
+				_pdesc_mq_unbind(q);
+				pdesc_pool_free(q->pool);
+			}
+
+			kfree(mq->queues[d]);
+		}
+
+		kfree(mq);
+	}
+}
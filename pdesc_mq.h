@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * Multi-queue Packet descriptor pools (header).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef PDESC_MQ_H
+#define PDESC_MQ_H
+
+#include <linux/types.h>
+#include <linux/netdevice.h>
+#include <linux/dmaengine.h>
+
+#include "packet_desc.h"
+
+/**
+ *
+ * Queue directions.
+ *
+ * @PDESC_MQ_TX: Netdev TX queues.
+ * @PDESC_MQ_RX: Netdev RX queues.
+ *
+ */
+enum pdesc_mq_dir {
+	PDESC_MQ_TX = 0,
+	PDESC_MQ_RX = 1,
+	PDESC_MQ_NDIRS
+};
+
+/**
+ *
+ * Multi-queue queue structure. Each netdev queue has its own Packet
+ * descriptor pool, DMA channel and CPU, so the queues don't share
+ * any lock or channel.
+ *
+ */
+struct pdesc_mq_queue {
+	struct pdesc_pool * pool;
+	struct dma_chan * chan;
+
+	/* CPU of the queue and IRQ of its DMA channel (-1 if not bound) */
+	int cpu;
+	int irq;
+};
+
+/**
+ *
+ * Multi-queue Packet descriptor pools structure. It maps the netdev
+ * queue indexes to Packet descriptor pools.
+ *
+ */
+struct pdesc_mq {
+	unsigned int nqueues[PDESC_MQ_NDIRS];
+	struct pdesc_mq_queue * queues[PDESC_MQ_NDIRS];
+};
+
+/**
+ *
+ * pdesc_mq_create - Create the Packet descriptor pools of a netdev.
+ * If name is not NULL, the statistics of each queue are enabled
+ * (dma_opl/pool/<name>-tx<n> and dma_opl/pool/<name>-rx<n>).
+ *
+ * @name: Name of the netdev or NULL.
+ * @ntx: Number of TX queues (at least one).
+ * @nrx: Number of RX queues.
+ * @gfp: Specific flags to request memory.
+ *
+ * Return: A Multi-queue Packet descriptor pools structure.
+ *
+ */
+struct pdesc_mq * pdesc_mq_create(const char * name, unsigned int ntx, \
+	unsigned int nrx, gfp_t gfp);
+
+/**
+ *
+ * pdesc_mq_bind - Bind a queue to a DMA channel and a CPU. The
+ * descriptors of the queue must be created with this channel (see
+ * pdesc_pool_lane_chan).
+ *
+ * @mq: Multi-queue Packet descriptor pools pointer.
+ * @dir: Queue direction.
+ * @index: Queue index.
+ * @chan: DMA channel.
+ * @cpu: CPU of the queue or -1.
+ * @irq: IRQ of the DMA channel or -1. Its affinity is set to cpu
+ *	(the DMA engine API doesn't expose the IRQ of a channel).
+ *
+ * Return: 0 if success and an error code otherwise (the queue is left
+ * unbound if the affinity of the IRQ cannot be set).
+ *
+ */
+int pdesc_mq_bind(struct pdesc_mq * mq, enum pdesc_mq_dir dir, \
+	unsigned int index, struct dma_chan * chan, int cpu, int irq);
+
+/**
+ *
+ * pdesc_mq_set_xps - Set the XPS map of the netdev to the CPUs of
+ * the TX queues, so each CPU transmits on its own queue.
+ *
+ * @mq: Multi-queue Packet descriptor pools pointer.
+ * @dev: Network device.
+ *
+ * Return: 0 if success and an error code otherwise.
+ *
+ */
+int pdesc_mq_set_xps(struct pdesc_mq * mq, struct net_device * dev);
+
+/**
+ *
+ * pdesc_mq_pool - Get the Packet descriptor pool of a queue.
+ *
+ * @mq: Multi-queue Packet descriptor pools pointer.
+ * @dir: Queue direction.
+ * @index: Queue index (e.g. skb_get_queue_mapping or the RX ring).
+ *
+ * Return: The Packet descriptor pool or NULL if the index is not valid.
+ *
+ */
+struct pdesc_pool * pdesc_mq_pool(struct pdesc_mq * mq, \
+	enum pdesc_mq_dir dir, unsigned int index);
+
+/**
+ *
+ * pdesc_mq_tx_pool - Get the Packet descriptor pool of the TX queue
+ * of a sk_buff (see ndo_start_xmit).
+ *
+ * @mq: Multi-queue Packet descriptor pools pointer.
+ * @skb: Socket buffer.
+ *
+ * Return: The Packet descriptor pool.
+ *
+ */
+struct pdesc_pool * pdesc_mq_tx_pool(struct pdesc_mq * mq, \
+	struct sk_buff * skb);
+
+/**
+ *
+ * pdesc_mq_free - Destroy the Packet descriptor pools of a netdev and
+ * clear the IRQ affinity hints. The pools must be empty.
+ *
+ * @mq: Multi-queue Packet descriptor pools pointer.
+ *
+ */
+void pdesc_mq_free(struct pdesc_mq * mq);
+
+#endif /* PDESC_MQ_H */
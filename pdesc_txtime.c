@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * Packet descriptor launch time scheduler (implementation).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include <linux/slab.h>
+#include <net/sock.h>
+
+#include "pdesc_txtime.h"
+
+static ktime_t _pdesc_txtime_now(struct pdesc_txtime * txt)
+{
+	return hrtimer_cb_get_time(&txt->timer);
+}
+
+static ktime_t _pdesc_txtime_submit_time(struct pdesc_txtime * txt, \
+	struct pdesc * desc)
+{
+	return ktime_sub_ns(desc->txtime,txt->lead_ns);
+}
+
+/* Return 1 if the descriptor is the earliest one */
+static int _pdesc_txtime_insert(struct pdesc_txtime * txt, \
+	struct pdesc * desc)
+{
+	struct rb_node ** p = &txt->queue.rb_root.rb_node;
+	struct rb_node * parent = NULL;
+	struct pdesc * d;
+	bool leftmost = true;
+
+	/* Same launch time: first queued, first sent */
+	while(*p != NULL) {
+		parent = *p;
+		d = rb_entry(parent,struct pdesc,txtime_node);
+
+		if(ktime_before(desc->txtime,d->txtime)) {
+			p = &parent->rb_left;
+		} else {
+			p = &parent->rb_right;
+			leftmost = false;
+		}
+	}
+
+	rb_link_node(&desc->txtime_node,parent,p);
+	rb_insert_color_cached(&desc->txtime_node,&txt->queue,leftmost);
+
+	return leftmost;
+}
+
+/* Not a hard timer: the descriptors are submitted from the handler */
+static void _pdesc_txtime_arm(struct pdesc_txtime * txt, \
+	struct pdesc * desc)
+{
+	hrtimer_start(&txt->timer,_pdesc_txtime_submit_time(txt,desc), \
+		HRTIMER_MODE_ABS_SOFT);
+}
+
+/* The counter is updated by the caller (lock held) */
+static void _pdesc_txtime_drop(struct pdesc_txtime * txt, \
+	struct pdesc * desc)
+{
+	if(txt->drop_f != NULL)
+		txt->drop_f(desc,txt->drop_param);
+}
+
+static enum hrtimer_restart _pdesc_txtime_timer(struct hrtimer * timer)
+{
+	struct pdesc_txtime * txt = \
+		container_of(timer,struct pdesc_txtime,timer);
+	struct rb_node * first;
+	struct pdesc * desc;
+	unsigned long flags;
+	ktime_t now = _pdesc_txtime_now(txt);
+
+	spin_lock_irqsave(&txt->lock,flags);
+
+	while((first = rb_first_cached(&txt->queue)) != NULL) {
+		desc = rb_entry(first,struct pdesc,txtime_node);
+
+		/* The timer is rearmed for the next descriptor */
+		if(ktime_after(_pdesc_txtime_submit_time(txt,desc),now)) {
+			_pdesc_txtime_arm(txt,desc);
+			break;
+		}
+
+		rb_erase_cached(first,&txt->queue);
+
+		if(ktime_after(now,desc->txtime)) {
+			if(txt->flags & PDESC_TXTIME_DROP_LATE) {
+				txt->dropped++;
+				spin_unlock_irqrestore(&txt->lock,flags);
+				_pdesc_txtime_drop(txt,desc);
+				spin_lock_irqsave(&txt->lock,flags);
+				continue;
+			}
+			txt->late++;
+		}
+
+		/* A descriptor that cannot be submitted is dropped */
+		if(pdesc_xfer_start(desc) != 0) {
+			txt->dropped++;
+			spin_unlock_irqrestore(&txt->lock,flags);
+			_pdesc_txtime_drop(txt,desc);
+			spin_lock_irqsave(&txt->lock,flags);
+		}
+	}
+
+	spin_unlock_irqrestore(&txt->lock,flags);
+
+	return HRTIMER_NORESTART;
+}
+
+struct pdesc_txtime * pdesc_txtime_create(clockid_t clockid, u64 lead_ns, \
+	unsigned int flags, void (*drop_f)(struct pdesc * desc, void * param), \
+	void * drop_param, gfp_t gfp)
+{
+	struct pdesc_txtime * txt = NULL;
+
+	txt = kzalloc(sizeof(*txt),gfp);
+	if(txt != NULL) {
+		txt->queue = RB_ROOT_CACHED;
+		spin_lock_init(&txt->lock);
+		hrtimer_setup(&txt->timer,_pdesc_txtime_timer,clockid, \
+			HRTIMER_MODE_ABS_SOFT);
+		txt->clockid = clockid;
+		txt->lead_ns = lead_ns;
+		txt->flags = flags;
+		txt->drop_f = drop_f;
+		txt->drop_param = drop_param;
+	}
+
+	return txt;
+}
+
+int pdesc_txtime_queue(struct pdesc_txtime * txt, struct pdesc * desc)
+{
+	struct sk_buff * skb = desc->skb;
+	unsigned long flags;
+	int late;
+
+	if(skb == NULL || skb->tstamp == 0)
+		return pdesc_xfer_start(desc);
+
+	/*
+	 * As sch_etf: the launch time must come from a full socket with
+	 * SO_TXTIME in the clock of the queue (e.g. a forwarded skb may
+	 * carry an RX timestamp).
+	 */
+	if(skb->sk == NULL || !sk_fullsock(skb->sk) || \
+		!sock_flag(skb->sk,SOCK_TXTIME) || \
+		skb->sk->sk_clockid != txt->clockid)
+		return -1;
+
+	desc->txtime = skb->tstamp;
+
+	spin_lock_irqsave(&txt->lock,flags);
+
+	late = ktime_before(desc->txtime,_pdesc_txtime_now(txt));
+	if(late) {
+		if(txt->flags & PDESC_TXTIME_DROP_LATE) {
+			txt->dropped++;
+			spin_unlock_irqrestore(&txt->lock,flags);
+			return -2;
+		}
+		txt->late++;
+	} else if(_pdesc_txtime_insert(txt,desc)) {
+		_pdesc_txtime_arm(txt,desc);
+	}
+
+	spin_unlock_irqrestore(&txt->lock,flags);
+
+	if(late)
+		return pdesc_xfer_start(desc);
+
+	return 0;
+}
+
+void pdesc_txtime_free(struct pdesc_txtime * txt)
+{
+	struct rb_node * first;
+
+	if(txt != NULL) {
+		hrtimer_cancel(&txt->timer);
+
+		while((first = rb_first_cached(&txt->queue)) != NULL) {
+			rb_erase_cached(first,&txt->queue);
+			txt->dropped++;
+			_pdesc_txtime_drop(txt, \
+				rb_entry(first,struct pdesc,txtime_node));
+		}
+
+		kfree(txt);
+	}
+}
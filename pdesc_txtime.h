@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * Packet descriptor launch time scheduler (header).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef PDESC_TXTIME_H
+#define PDESC_TXTIME_H
+
+#include <linux/types.h>
+#include <linux/rbtree.h>
+#include <linux/hrtimer.h>
+#include <linux/spinlock.h>
+
+#include "packet_desc.h"
+
+/* Late descriptors are dropped instead of being sent at once */
+#define PDESC_TXTIME_DROP_LATE 0x1
+
+/**
+ *
+ * Packet descriptor launch time scheduler. The prepared TX descriptors
+ * are kept in a queue ordered by launch time (skb->tstamp with
+ * SO_TXTIME semantics) and each one is submitted from an hrtimer
+ * lead_ns before its launch time. The timer runs in softirq context
+ * (the DMA engine drivers take sleeping locks on PREEMPT_RT), so
+ * lead_ns must cover the softirq latency too.
+ *
+ */
+struct pdesc_txtime {
+	/* Descriptors ordered by launch time */
+	struct rb_root_cached queue;
+	spinlock_t lock;
+
+	/* Timer of the earliest descriptor */
+	struct hrtimer timer;
+	clockid_t clockid;
+
+	/* Time to submit ahead of the launch time (issue latency) */
+	u64 lead_ns;
+	unsigned int flags;
+
+	/* Called for the dropped descriptors (any context) */
+	void (*drop_f)(struct pdesc * desc, void * param);
+	void * drop_param;
+
+	/* Descriptors sent late and dropped (lock held) */
+	unsigned long late;
+	unsigned long dropped;
+};
+
+/**
+ *
+ * pdesc_txtime_create - Create a new launch time scheduler.
+ *
+ * @clockid: Clock of the launch times (e.g. CLOCK_TAI). The sockets
+ *	must use the same clock (SO_TXTIME).
+ * @lead_ns: Time to submit a descriptor ahead of its launch time.
+ * @flags: PDESC_TXTIME_* flags.
+ * @drop_f: Function called with the dropped descriptors (optional).
+ * @drop_param: Parameter of drop_f.
+ * @gfp: Specific flags to request memory.
+ *
+ * Return: A launch time scheduler.
+ *
+ */
+struct pdesc_txtime * pdesc_txtime_create(clockid_t clockid, u64 lead_ns, \
+	unsigned int flags, void (*drop_f)(struct pdesc * desc, void * param), \
+	void * drop_param, gfp_t gfp);
+
+/**
+ *
+ * pdesc_txtime_queue - Queue a prepared TX Packet descriptor (see
+ * pdesc_copy_to and pdesc_xfer_prep). The launch time is taken from
+ * the sk_buff of the descriptor. A descriptor without launch time is
+ * started at once. A queued descriptor that cannot be started by the
+ * timer is dropped.
+ *
+ * @txt: Launch time scheduler pointer.
+ * @desc: Packet descriptor pointer.
+ *
+ * Return: 0 if success, -1 if the launch time is not valid (the
+ * sk_buff has no full socket with SO_TXTIME in the clock of the
+ * scheduler) or the descriptor couldn't be started, and -2 if the
+ * descriptor is late
+ * and PDESC_TXTIME_DROP_LATE is set (it is not queued).
+ *
+ */
+int pdesc_txtime_queue(struct pdesc_txtime * txt, struct pdesc * desc);
+
+/**
+ *
+ * pdesc_txtime_free - Destroy a launch time scheduler. The queued
+ * descriptors are dropped.
+ *
+ * @txt: Launch time scheduler pointer.
+ *
+ */
+void pdesc_txtime_free(struct pdesc_txtime * txt);
+
+#endif /* PDESC_TXTIME_H */
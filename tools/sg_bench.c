@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * SG construction microbenchmark (user space).
+ *
+ * It measures dma_sg_table_create (the page walk of dma_block.c and
+ * dma_sg.c plus the SG table allocation) for several buffer sizes and
+ * offsets. The buffers are fake kernel buffers (see shim/shim.h):
+ *
+ *	contig: linear mapping (physically contiguous).
+ *	vmalloc: vmalloc area, physically contiguous in runs of pages.
+ *	pages: page array (e.g. pinned user pages), same runs of pages.
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include <time.h>
+#include <unistd.h>
+
+#include "shim.h"
+#include "dma_block.h"
+#include "dma_sg.h"
+#include "dma_sg_table.h"
+
+#define SG_BENCH_INLINE_SG 4
+
+static const size_t sg_bench_sizes[] = {
+	4096, 16384, 65536, 262144, 1048576, 4194304, 16777216,
+};
+
+static const size_t sg_bench_offsets[] = {
+	0, 64, 2048, 4095,
+};
+
+#define SG_BENCH_MAX_SIZE (16777216+4096)
+#define SG_BENCH_MAX_PAGES (SG_BENCH_MAX_SIZE/PAGE_SIZE+1)
+
+enum sg_bench_shape {
+	SG_BENCH_CONTIG,
+	SG_BENCH_VMALLOC,
+	SG_BENCH_PAGES,
+};
+
+static const char * const sg_bench_shape_names[] = {
+	"contig", "vmalloc", "pages",
+};
+
+/* Page array DMA block */
+struct sg_bench_pages {
+	struct page ** pages;
+	unsigned int npages;
+	unsigned int offset;
+	size_t size;
+};
+
+static void * sg_bench_pages_get_buffer(struct dma_block * block)
+{
+	return NULL;
+}
+
+static size_t sg_bench_pages_get_size(struct dma_block * block)
+{
+	struct sg_bench_pages * priv = block->priv;
+
+	return priv->size;
+}
+
+static struct page ** sg_bench_pages_get_pages(struct dma_block * block, \
+	unsigned int * npages, unsigned int * offset)
+{
+	struct sg_bench_pages * priv = block->priv;
+
+	*npages = priv->npages;
+	*offset = priv->offset;
+
+	return priv->pages;
+}
+
+static struct dma_block_op sg_bench_pages_ops = {
+	.get_buffer = sg_bench_pages_get_buffer,
+	.get_size = sg_bench_pages_get_size,
+	.get_pages = sg_bench_pages_get_pages,
+};
+
+static struct page * sg_bench_page_array[SG_BENCH_MAX_PAGES];
+
+/*
+ * Physical layout of the vmalloc area and the page array: runs of
+ * contiguous pages separated by a hole.
+ */
+static void sg_bench_init_memory(unsigned int run)
+{
+	unsigned long i;
+
+	shim_nr_pfns = 2*SG_BENCH_MAX_PAGES+1;
+	mem_map = calloc(shim_nr_pfns,sizeof(*mem_map));
+
+	shim_vmalloc_pages = SG_BENCH_MAX_PAGES;
+	shim_vmalloc_pfns = calloc(shim_vmalloc_pages, \
+		sizeof(*shim_vmalloc_pfns));
+
+	if(mem_map == NULL || shim_vmalloc_pfns == NULL) {
+		fprintf(stderr,"Couldn't allocate the fake memory\n");
+		exit(1);
+	}
+
+	for(i = 0; i < shim_vmalloc_pages; i++) {
+		shim_vmalloc_pfns[i] = i+i/run;
+		sg_bench_page_array[i] = pfn_to_page(shim_vmalloc_pfns[i]);
+	}
+}
+
+static struct dma_block * sg_bench_block_create(enum sg_bench_shape shape, \
+	size_t size, size_t offset)
+{
+	struct dma_block * block;
+	struct sg_bench_pages * priv;
+
+	switch(shape) {
+	case SG_BENCH_CONTIG:
+		return simple_dma_block_create( \
+			(void *)(SHIM_LINEAR_BASE+offset),size,GFP_KERNEL);
+	case SG_BENCH_VMALLOC:
+		return simple_dma_block_create( \
+			(void *)(SHIM_VMALLOC_BASE+offset),size,GFP_KERNEL);
+	default:
+		block = dma_block_create(sizeof(*priv),GFP_KERNEL);
+		if(block == NULL)
+			return NULL;
+
+		priv = block->priv;
+		priv->pages = sg_bench_page_array;
+		priv->npages = DIV_ROUND_UP(offset+size,PAGE_SIZE);
+		priv->offset = offset;
+		priv->size = size;
+		dma_block_op_bind(block,&sg_bench_pages_ops);
+
+		return block;
+	}
+}
+
+static void sg_bench_block_free(enum sg_bench_shape shape, \
+	struct dma_block * block)
+{
+	if(shape == SG_BENCH_PAGES)
+		dma_block_free(block);
+	else
+		simple_dma_block_free(block);
+}
+
+static uint64_t sg_bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static int sg_bench_run(enum sg_bench_shape shape, size_t size, \
+	size_t offset, unsigned int max_seg, unsigned long iterations)
+{
+	struct scatterlist sgl_inline[SG_BENCH_INLINE_SG];
+	struct list_head list_dma_sg;
+	struct sg_table sgt;
+	struct dma_block * block;
+	struct dma_sg * sg;
+	unsigned long allocs;
+	unsigned long i;
+	uint64_t start;
+	uint64_t elapsed;
+	int nents = 0;
+
+	block = sg_bench_block_create(shape,size,offset);
+	sg = dma_sg_create(block,GFP_KERNEL);
+	if(block == NULL || sg == NULL)
+		return -1;
+
+	INIT_LIST_HEAD(&list_dma_sg);
+	list_add_tail(&sg->node,&list_dma_sg);
+
+	allocs = shim_nr_allocs;
+	start = sg_bench_now();
+
+	for(i = 0; i < iterations; i++) {
+		nents = dma_sg_table_create(&sgt,&list_dma_sg,max_seg, \
+			ULONG_MAX,sgl_inline,SG_BENCH_INLINE_SG,GFP_KERNEL);
+		if(nents < 0)
+			break;
+		dma_sg_table_free(&sgt,SG_BENCH_INLINE_SG);
+	}
+
+	elapsed = sg_bench_now()-start;
+	allocs = shim_nr_allocs-allocs;
+
+	dma_sg_free(sg);
+	sg_bench_block_free(shape,block);
+
+	if(nents < 0) {
+		fprintf(stderr,"Couldn't build the SG table (%d)\n",nents);
+		return -1;
+	}
+
+	printf("%-8s %9zu %5zu %7d %10.1f %8.2f %7.2f\n", \
+		sg_bench_shape_names[shape],size,offset,nents, \
+		(double)elapsed/iterations,(double)elapsed/iterations/nents, \
+		(double)allocs/iterations);
+
+	return 0;
+}
+
+static void sg_bench_usage(const char * name)
+{
+	fprintf(stderr,"Usage: %s [-s contig|vmalloc|pages] [-i iterations]\n" \
+		"\t[-m max_seg] [-r run]\n\n" \
+		"\t-s: buffer shape (default: all)\n" \
+		"\t-i: iterations per size and offset (default: 1000)\n" \
+		"\t-m: maximum size of a SG entry (default: 65536)\n" \
+		"\t-r: contiguous pages of vmalloc/pages shapes (default: 1)\n", \
+		name);
+}
+
+int main(int argc, char * argv[])
+{
+	unsigned long iterations = 1000;
+	unsigned int max_seg = 65536;
+	unsigned int run = 1;
+	int first = SG_BENCH_CONTIG;
+	int last = SG_BENCH_PAGES;
+	unsigned int i;
+	unsigned int j;
+	int shape;
+	int opt;
+
+	while((opt = getopt(argc,argv,"s:i:m:r:h")) != -1) {
+		switch(opt) {
+		case 's':
+			for(first = SG_BENCH_CONTIG; first <= SG_BENCH_PAGES; first++)
+				if(strcmp(optarg,sg_bench_shape_names[first]) == 0)
+					break;
+			if(first > SG_BENCH_PAGES) {
+				sg_bench_usage(argv[0]);
+				return 1;
+			}
+			last = first;
+			break;
+		case 'i':
+			iterations = strtoul(optarg,NULL,0);
+			break;
+		case 'm':
+			max_seg = strtoul(optarg,NULL,0);
+			break;
+		case 'r':
+			run = strtoul(optarg,NULL,0);
+			break;
+		default:
+			sg_bench_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if(iterations == 0 || max_seg < PAGE_SIZE || run == 0) {
+		sg_bench_usage(argv[0]);
+		return 1;
+	}
+
+	max_seg &= PAGE_MASK;
+	sg_bench_init_memory(run);
+
+	printf("%-8s %9s %5s %7s %10s %8s %7s\n","shape","size","off", \
+		"nents","ns/table","ns/ent","allocs");
+
+	for(shape = first; shape <= last; shape++)
+		for(i = 0; i < sizeof(sg_bench_sizes)/sizeof(size_t); i++)
+			for(j = 0; j < sizeof(sg_bench_offsets)/sizeof(size_t); j++)
+				if(sg_bench_run(shape,sg_bench_sizes[i], \
+					sg_bench_offsets[j],max_seg,iterations) < 0)
+					return 1;
+
+	return 0;
+}
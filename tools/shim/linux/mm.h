@@ -0,0 +1,2 @@
+/* User space shim: see shim.h */
+#include "../shim.h"
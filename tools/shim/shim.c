@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * User space shim for the kernel helpers used by the SG
+ * construction code (implementation).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include "shim.h"
+
+unsigned long shim_nr_allocs;
+
+struct page * mem_map;
+unsigned long shim_nr_pfns;
+unsigned long * shim_vmalloc_pfns;
+unsigned long shim_vmalloc_pages;
+
+static void sg_init_table(struct scatterlist * sgl, unsigned int nents)
+{
+	memset(sgl,0,sizeof(*sgl)*nents);
+	sgl[nents-1].page_link |= SG_END;
+}
+
+static void sg_chain(struct scatterlist * prv, unsigned int prv_nents, \
+	struct scatterlist * sgl)
+{
+	prv[prv_nents-1].offset = 0;
+	prv[prv_nents-1].length = 0;
+	prv[prv_nents-1].page_link = ((unsigned long)sgl | SG_CHAIN) & ~SG_END;
+}
+
+/* Port of __sg_alloc_table (lib/scatterlist.c) */
+int __sg_alloc_table(struct sg_table * table, unsigned int nents, \
+	unsigned int max_ents, struct scatterlist * first_chunk, \
+	unsigned int nents_first_chunk, gfp_t gfp, sg_alloc_fn * alloc_fn)
+{
+	struct scatterlist * sg;
+	struct scatterlist * prv = NULL;
+	unsigned int curr_max_ents = nents_first_chunk ? nents_first_chunk : \
+		max_ents;
+	unsigned int prv_max_ents = 0;
+	unsigned int left;
+
+	memset(table,0,sizeof(*table));
+
+	if(nents == 0)
+		return -EINVAL;
+
+	left = nents;
+
+	do {
+		unsigned int sg_size;
+		unsigned int alloc_size = left;
+
+		if(alloc_size > curr_max_ents) {
+			alloc_size = curr_max_ents;
+			sg_size = alloc_size-1;
+		} else {
+			sg_size = alloc_size;
+		}
+
+		left -= sg_size;
+
+		if(first_chunk) {
+			sg = first_chunk;
+			first_chunk = NULL;
+		} else {
+			sg = alloc_fn(alloc_size,gfp);
+		}
+
+		if(sg == NULL) {
+			if(prv)
+				table->nents = ++table->orig_nents;
+			return -ENOMEM;
+		}
+
+		sg_init_table(sg,alloc_size);
+		table->nents = table->orig_nents += sg_size;
+
+		if(prv)
+			sg_chain(prv,prv_max_ents,sg);
+		else
+			table->sgl = sg;
+
+		if(!left)
+			sg[sg_size-1].page_link |= SG_END;
+
+		prv = sg;
+		prv_max_ents = curr_max_ents;
+		curr_max_ents = max_ents;
+	} while(left);
+
+	return 0;
+}
+
+/* Port of __sg_free_table (lib/scatterlist.c) */
+void __sg_free_table(struct sg_table * table, unsigned int max_ents, \
+	unsigned int nents_first_chunk, sg_free_fn * free_fn, \
+	unsigned int num_ents)
+{
+	struct scatterlist * sgl;
+	struct scatterlist * next;
+	unsigned int curr_max_ents = nents_first_chunk ? nents_first_chunk : \
+		max_ents;
+
+	if(table->sgl == NULL)
+		return;
+
+	sgl = table->sgl;
+
+	while(num_ents) {
+		unsigned int alloc_size = num_ents;
+		unsigned int sg_size;
+
+		if(alloc_size > curr_max_ents) {
+			next = sg_chain_ptr(&sgl[curr_max_ents-1]);
+			alloc_size = curr_max_ents;
+			sg_size = alloc_size-1;
+		} else {
+			sg_size = alloc_size;
+			next = NULL;
+		}
+
+		num_ents -= sg_size;
+		if(nents_first_chunk)
+			nents_first_chunk = 0;
+		else
+			free_fn(sgl,alloc_size);
+
+		sgl = next;
+		curr_max_ents = max_ents;
+	}
+
+	table->sgl = NULL;
+}
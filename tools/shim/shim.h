@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * User space shim for the kernel helpers used by the SG
+ * construction code (header).
+ *
+ * Physical memory is simulated by an array of struct page. The
+ * linear mapping and the vmalloc area are fake address ranges:
+ * the buffers are never dereferenced by the SG construction code.
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef SHIM_H
+#define SHIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+
+/* Types */
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef unsigned int gfp_t;
+typedef uint64_t dma_addr_t;
+typedef uint64_t phys_addr_t;
+
+#define GFP_KERNEL 0
+#define GFP_ATOMIC 1
+
+#define EINVAL 22
+#define ENOMEM 12
+
+struct device;
+
+enum dma_data_direction {
+	DMA_BIDIRECTIONAL = 0,
+	DMA_TO_DEVICE = 1,
+	DMA_FROM_DEVICE = 2,
+	DMA_NONE = 3
+};
+
+/* Kernel helpers */
+
+#define min(a,b) ((a) < (b) ? (a) : (b))
+#define max(a,b) ((a) > (b) ? (a) : (b))
+#define min_t(t,a,b) min((t)(a),(t)(b))
+#define max_t(t,a,b) max((t)(a),(t)(b))
+#define min3(a,b,c) min(min(a,b),c)
+#define DIV_ROUND_UP(n,d) (((n)+(d)-1)/(d))
+#define round_up(x,y) ((((x)-1) | ((__typeof__(x))((y)-1)))+1)
+#define container_of(ptr,type,member) \
+	((type *)((char *)(ptr)-offsetof(type,member)))
+#define unlikely(x) (x)
+#define BUG_ON(x) do { if(x) abort(); } while(0)
+
+/* Memory allocation */
+
+extern unsigned long shim_nr_allocs;
+
+static inline void * kmalloc(size_t size, gfp_t gfp)
+{
+	shim_nr_allocs++;
+	return malloc(size);
+}
+
+static inline void * kzalloc(size_t size, gfp_t gfp)
+{
+	shim_nr_allocs++;
+	return calloc(1,size);
+}
+
+static inline void * kmalloc_array(size_t n, size_t size, gfp_t gfp)
+{
+	return kmalloc(n*size,gfp);
+}
+
+static inline void * kcalloc(size_t n, size_t size, gfp_t gfp)
+{
+	return kzalloc(n*size,gfp);
+}
+
+#define kvmalloc_array kmalloc_array
+
+static inline void kfree(const void * p)
+{
+	free((void *)p);
+}
+
+#define kvfree kfree
+
+/* Pages and address spaces */
+
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1UL << PAGE_SHIFT)
+#define PAGE_MASK (~(PAGE_SIZE-1))
+#define offset_in_page(p) ((unsigned long)(p) & ~PAGE_MASK)
+
+struct page {
+	unsigned long flags;
+};
+
+extern struct page * mem_map;
+extern unsigned long shim_nr_pfns;
+extern unsigned long * shim_vmalloc_pfns;
+extern unsigned long shim_vmalloc_pages;
+
+#define SHIM_LINEAR_BASE 0x100000000000UL
+#define SHIM_VMALLOC_BASE 0x200000000000UL
+
+#define page_to_pfn(p) ((unsigned long)((p)-mem_map))
+#define pfn_to_page(pfn) (mem_map+(pfn))
+#define nth_page(p,n) pfn_to_page(page_to_pfn(p)+(n))
+#define page_to_phys(p) ((phys_addr_t)page_to_pfn(p) << PAGE_SHIFT)
+
+static inline int is_vmalloc_addr(const void * x)
+{
+	unsigned long addr = (unsigned long)x;
+
+	return addr >= SHIM_VMALLOC_BASE && \
+		addr < SHIM_VMALLOC_BASE+shim_vmalloc_pages*PAGE_SIZE;
+}
+
+static inline struct page * virt_to_page(const void * x)
+{
+	return pfn_to_page(((unsigned long)x-SHIM_LINEAR_BASE) >> PAGE_SHIFT);
+}
+
+static inline struct page * vmalloc_to_page(const void * x)
+{
+	unsigned long idx = ((unsigned long)x-SHIM_VMALLOC_BASE) >> PAGE_SHIFT;
+
+	return pfn_to_page(shim_vmalloc_pfns[idx]);
+}
+
+/* Linked lists */
+
+struct list_head {
+	struct list_head * next;
+	struct list_head * prev;
+};
+
+#define LIST_HEAD_INIT(name) { &(name), &(name) }
+
+static inline void INIT_LIST_HEAD(struct list_head * list)
+{
+	list->next = list;
+	list->prev = list;
+}
+
+static inline void list_add_tail(struct list_head * n, \
+	struct list_head * head)
+{
+	n->prev = head->prev;
+	n->next = head;
+	head->prev->next = n;
+	head->prev = n;
+}
+
+static inline void list_del(struct list_head * entry)
+{
+	entry->prev->next = entry->next;
+	entry->next->prev = entry->prev;
+}
+
+static inline int list_empty(const struct list_head * head)
+{
+	return head->next == head;
+}
+
+#define list_entry(ptr,type,member) container_of(ptr,type,member)
+#define list_first_entry(ptr,type,member) \
+	list_entry((ptr)->next,type,member)
+#define list_for_each(pos,head) \
+	for(pos = (head)->next; pos != (head); pos = pos->next)
+#define list_for_each_safe(pos,n,head) \
+	for(pos = (head)->next, n = pos->next; pos != (head); \
+		pos = n, n = pos->next)
+
+/* Scatterlists (see lib/scatterlist.c) */
+
+struct scatterlist {
+	unsigned long page_link;
+	unsigned int offset;
+	unsigned int length;
+	dma_addr_t dma_address;
+	unsigned int dma_length;
+};
+
+struct sg_table {
+	struct scatterlist * sgl;
+	unsigned int nents;
+	unsigned int orig_nents;
+};
+
+#define SG_CHAIN 0x01UL
+#define SG_END 0x02UL
+#define SG_PAGE_LINK_MASK (SG_CHAIN | SG_END)
+#define SG_MAX_SINGLE_ALLOC (PAGE_SIZE / sizeof(struct scatterlist))
+
+#define sg_is_chain(sg) ((sg)->page_link & SG_CHAIN)
+#define sg_is_last(sg) ((sg)->page_link & SG_END)
+#define sg_chain_ptr(sg) \
+	((struct scatterlist *)((sg)->page_link & ~SG_PAGE_LINK_MASK))
+
+static inline struct page * sg_page(struct scatterlist * sg)
+{
+	return (struct page *)((sg)->page_link & ~SG_PAGE_LINK_MASK);
+}
+
+static inline void sg_set_page(struct scatterlist * sg, \
+	struct page * page, unsigned int len, unsigned int offset)
+{
+	sg->page_link = (sg->page_link & SG_END) | (unsigned long)page;
+	sg->offset = offset;
+	sg->length = len;
+}
+
+static inline struct scatterlist * sg_next(struct scatterlist * sg)
+{
+	if(sg_is_last(sg))
+		return NULL;
+
+	sg++;
+	if(sg_is_chain(sg))
+		sg = sg_chain_ptr(sg);
+
+	return sg;
+}
+
+#define for_each_sg(sglist,sg,nr,__i) \
+	for(__i = 0, sg = (sglist); __i < (nr); __i++, sg = sg_next(sg))
+
+typedef struct scatterlist * (sg_alloc_fn)(unsigned int, gfp_t);
+typedef void (sg_free_fn)(struct scatterlist *, unsigned int);
+
+int __sg_alloc_table(struct sg_table * table, unsigned int nents, \
+	unsigned int max_ents, struct scatterlist * first_chunk, \
+	unsigned int nents_first_chunk, gfp_t gfp, sg_alloc_fn * alloc_fn);
+
+void __sg_free_table(struct sg_table * table, unsigned int max_ents, \
+	unsigned int nents_first_chunk, sg_free_fn * free_fn, \
+	unsigned int num_ents);
+
+#endif /* SHIM_H */
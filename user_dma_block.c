@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * User DMA Block functions (implementation).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#include <linux/slab.h>
+#include <linux/mm.h>
+
+#include "user_dma_block.h"
+
+static void * user_dma_block_get_buffer(struct dma_block * block)
+{
+	/* There is no kernel mapping for the user buffer */
+	return NULL;
+}
+
+static size_t user_dma_block_get_size(struct dma_block * block)
+{
+	struct user_dma_block * block_priv = block->priv;
+
+	return block_priv->size;
+}
+
+static struct page ** user_dma_block_get_pages(struct dma_block * block, \
+	unsigned int * npages, unsigned int * offset)
+{
+	struct user_dma_block * block_priv = block->priv;
+
+	*npages = block_priv->npages;
+	*offset = block_priv->offset;
+
+	return block_priv->pages;
+}
+
+static struct dma_block_op user_dma_block_ops = {
+	.get_buffer = user_dma_block_get_buffer,
+	.get_size = user_dma_block_get_size,
+	.get_pages = user_dma_block_get_pages
+};
+
+static void _user_dma_block_unpin(struct user_dma_block * block_priv)
+{
+	if(block_priv->pinned) {
+		unpin_user_pages_dirty_lock(block_priv->pages, \
+			block_priv->npages, block_priv->write);
+		block_priv->pinned = 0;
+	}
+}
+
+static void _user_dma_block_release_work(struct work_struct * work)
+{
+	struct user_dma_block * block_priv = \
+		container_of(work,struct user_dma_block,release_work);
+
+	_user_dma_block_unpin(block_priv);
+}
+
+struct dma_block * user_dma_block_create(unsigned long uaddr,\
+	size_t size, int write, gfp_t gfp)
+{
+	struct dma_block * block = NULL;
+	struct user_dma_block * block_priv;
+	unsigned int gup_flags = FOLL_LONGTERM;
+	unsigned int npages;
+	int r;
+
+	if(size == 0)
+		return NULL;
+
+	npages = DIV_ROUND_UP(offset_in_page(uaddr)+size,PAGE_SIZE);
+
+	block = dma_block_create(sizeof(*block_priv),gfp);
+	if(block == NULL)
+		return NULL;
+
+	block_priv = block->priv;
+
+	block_priv->pages = kvmalloc_array(npages, \
+		sizeof(*block_priv->pages),gfp);
+	if(block_priv->pages == NULL) {
+		dma_block_free(block);
+		return NULL;
+	}
+
+	if(write)
+		gup_flags |= FOLL_WRITE;
+
+	r = pin_user_pages_fast(uaddr & PAGE_MASK,npages,gup_flags, \
+		block_priv->pages);
+	if(r != npages) {
+		if(r > 0)
+			unpin_user_pages(block_priv->pages,r);
+
+		kvfree(block_priv->pages);
+		dma_block_free(block);
+		return NULL;
+	}
+
+	block_priv->uaddr = uaddr;
+	block_priv->size = size;
+	block_priv->npages = npages;
+	block_priv->offset = offset_in_page(uaddr);
+	block_priv->write = write;
+	block_priv->pinned = 1;
+	INIT_WORK(&block_priv->release_work,_user_dma_block_release_work);
+
+	dma_block_op_bind(block,&user_dma_block_ops);
+
+	return block;
+}
+
+void user_dma_block_complete(struct dma_block * block)
+{
+	struct user_dma_block * block_priv = block->priv;
+
+	schedule_work(&block_priv->release_work);
+}
+
+void user_dma_block_free(struct dma_block * block)
+{
+	struct user_dma_block * block_priv = block->priv;
+
+	flush_work(&block_priv->release_work);
+	_user_dma_block_unpin(block_priv);
+
+	kvfree(block_priv->pages);
+	dma_block_free(block);
+}
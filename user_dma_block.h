@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2016 University of Granada
+ * 		Miguel Jimenez Lopez <klyone@ugr.es>
+ *
+ * User DMA Block functions (header).
+ *
+ * This source code is licensed under the GNU General Public License,
+ * Version 2. See the file COPYING for more details.
+*/
+
+#ifndef USER_DMA_BLOCK_H
+#define USER_DMA_BLOCK_H
+
+#include <linux/types.h>
+#include <linux/mm_types.h>
+#include <linux/workqueue.h>
+
+#include "dma_block.h"
+
+/**
+ *
+ * User DMA block structure. It pins a user space buffer
+ * so that the device can access it directly (zero-copy).
+ *
+ * The block has no kernel virtual mapping: the buffer is
+ * only described by its page array.
+ *
+ */
+struct user_dma_block {
+	/* User space address of the buffer */
+	unsigned long uaddr;
+
+	/* Data buffer size */
+	size_t size;
+
+	/* Pinned pages */
+	struct page ** pages;
+	unsigned int npages;
+
+	/* Offset of the data within the first page */
+	unsigned int offset;
+
+	/* Will the device write into the buffer? */
+	int write;
+
+	/* Are the pages still pinned? */
+	int pinned;
+
+	/* Deferred unpinning (atomic context) */
+	struct work_struct release_work;
+};
+
+/**
+ *
+ * user_dma_block_create - Pin a user space buffer and create
+ * a new user DMA block for it.
+ *
+ * It must be called from the context of the process that owns
+ * the buffer.
+ *
+ * @uaddr: User space address of the buffer.
+ * @size: Buffer size.
+ * @write: Non-zero if the device will write into the buffer
+ * 	(DMA_FROM_DEVICE), zero otherwise.
+ * @gfp: Specific flags to request memory.
+ *
+ * Return: A initialized DMA block or NULL if the buffer
+ * could not be pinned.
+ *
+ */
+struct dma_block * user_dma_block_create(unsigned long uaddr,\
+	size_t size, int write, gfp_t gfp);
+
+/**
+ *
+ * user_dma_block_complete - Release the pinned pages once the
+ * DMA transfer has completed. The pages are marked as dirty if
+ * the device has written into them.
+ *
+ * It must be called after the DMA mapping of the block is released
+ * (dma_xfer_free), not from the DMA callback: the unmap may still
+ * write into the pages (bounce buffers, cache invalidation). It can
+ * be called from any context since the unpinning is deferred to
+ * process context.
+ *
+ * @block: Block pointer.
+ *
+ */
+void user_dma_block_complete(struct dma_block * block);
+
+/**
+ *
+ * user_dma_block_free - Destroy a user DMA block. The pages
+ * are released if user_dma_block_complete has not been called.
+ *
+ * @block: Block pointer.
+ *
+ */
+void user_dma_block_free(struct dma_block * block);
+
+#endif /* USER_DMA_BLOCK_H */